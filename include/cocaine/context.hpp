@@ -28,6 +28,7 @@
 #include <asio/local/stream_protocol.hpp>
 
 #include <blackhole/attributes.hpp>
+#include <blackhole/severity.hpp>
 
 #include "cocaine/common.hpp"
 #include "cocaine/forwards.hpp"
@@ -52,6 +53,11 @@ public:
     void
     logger_filter(filter_t new_filter) = 0;
 
+    /// Tells whether a record with the given severity can pass the current logger filter at all.
+    virtual
+    bool
+    logger_enabled(blackhole::severity_t severity) const = 0;
+
     virtual
     api::repository_t&
     repository() const = 0;
@@ -106,6 +112,19 @@ public:
     auto
     engine() -> execution_unit_t& = 0;
 
+    /// Invokes the given function for every execution unit of the pool.
+    virtual
+    auto
+    each_engine(const std::function<void(execution_unit_t&)>& fn) -> void = 0;
+
+    /// Returns the shared pool of threads for CPU-bound work, which otherwise would block reactors.
+    ///
+    /// The pool is started on the first call. Work spawned here is completed before the execution
+    /// units are stopped, while spawning new work from the outside fails from then on.
+    virtual
+    auto
+    executor() -> api::executor_t& = 0;
+
     /// Binds a new socket on the specified endpoint and starts listening for new connections.
     template<typename Protocol>
     auto
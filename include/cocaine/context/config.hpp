@@ -93,6 +93,71 @@ public:
         virtual
         size_t
         pool() const = 0;
+
+        // Whether to compress outgoing message headers using HPACK dynamic table indexing. Clients
+        // must be able to maintain the dynamic table on their side for this to be enabled.
+        virtual
+        bool
+        compression() const = 0;
+
+        // Maximum number of already received messages a session handles in one go before yielding
+        // to other sessions of the same I/O thread.
+        virtual
+        size_t
+        budget() const = 0;
+
+        // Maximum number of outgoing messages a session writes in one go before yielding to other
+        // sessions of the same I/O thread. Messages are small compared to the socket buffers, so
+        // it's larger than the read budget, since every yield costs a reactor round trip.
+        virtual
+        size_t
+        batch() const = 0;
+
+        // Socket I/O backend of client connections, either "asio", which is the default, or "uring"
+        // for Linux io_uring. Engines fall back to asio when io_uring is not available.
+        virtual
+        const std::string&
+        transport() const = 0;
+
+        // Whether every I/O thread binds its own SO_REUSEPORT acceptor for each service and accepts
+        // connections right onto its reactor, leaving the load spreading to the kernel. Otherwise,
+        // all the connections are accepted by a single thread and handed off to the I/O threads.
+        virtual
+        bool
+        reuseport() const = 0;
+    };
+
+    // Thread placement. CPU sets are specified in the Linux CPU list format, e.g. "0-3,8", and empty
+    // ones don't pin anything.
+    struct threads_t {
+        virtual
+        ~threads_t() {}
+
+        // CPU sets of the I/O threads, assigned to them round-robin. Either configured explicitly or
+        // one per NUMA node, if set to "numa".
+        virtual
+        const std::vector<cpuset_t>&
+        engines() const = 0;
+
+        virtual
+        const cpuset_t&
+        acceptor() const = 0;
+
+        // Threads of the plugin executors and other background workers.
+        virtual
+        const cpuset_t&
+        executors() const = 0;
+
+        // Number of threads of the shared executor for CPU-bound work.
+        virtual
+        size_t
+        workers() const = 0;
+
+        // CPUs of the NUMA node the configured network interface is attached to. New connections are
+        // handed off to the I/O threads pinned within this set first.
+        virtual
+        const cpuset_t&
+        interface() const = 0;
     };
 
     struct logging_t {
@@ -119,6 +184,11 @@ public:
         virtual
         const dynamic_t&
         args() const = 0;
+
+        // Connection options of the component, e.g. write coalescing thresholds for services.
+        virtual
+        const dynamic_t&
+        network() const = 0;
     };
 
     // Component group such as storages, services or unicorns
@@ -145,6 +215,10 @@ public:
     const network_t&
     network() const = 0;
 
+    virtual
+    const threads_t&
+    threads() const = 0;
+
     virtual
     const logging_t&
     logging() const = 0;
@@ -0,0 +1,76 @@
+/*
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_CPUSET_HPP
+#define COCAINE_CPUSET_HPP
+
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace cocaine {
+
+// Set of CPUs threads are pinned to. An empty set doesn't restrict anything.
+class cpuset_t {
+    // Sorted and unique.
+    std::vector<unsigned> cpus;
+
+public:
+    cpuset_t() = default;
+
+    // Parses the Linux CPU list format, e.g. "0-3,8,10-11". Throws error_t if malformed.
+    explicit
+    cpuset_t(const std::string& list);
+
+    // CPUs the calling thread is allowed to run on.
+    static
+    auto
+    current() -> cpuset_t;
+
+    // CPUs of every online NUMA node, empty if the topology is unknown.
+    static
+    auto
+    numa() -> std::vector<cpuset_t>;
+
+    // CPUs of the NUMA node the network interface is attached to, empty if unknown.
+    static
+    auto
+    interface(const std::string& name) -> cpuset_t;
+
+    auto
+    empty() const -> bool {
+        return cpus.empty();
+    }
+
+    // Whether the other set is a subset of this one.
+    auto
+    contains(const cpuset_t& other) const -> bool;
+
+    // Pins the calling thread to this set, does nothing if it's empty.
+    auto
+    apply() const -> std::error_code;
+
+    // Formats the set back into the CPU list format.
+    auto
+    string() const -> std::string;
+};
+
+} // namespace cocaine
+
+#endif
@@ -32,6 +32,11 @@ struct defaults {
 
     // Defaults for networking.
     static const std::string endpoint;
+    static const unsigned int pull_budget;
+    static const unsigned int flush_batch;
+
+    // Number of executor threads, when the number of CPUs is unknown.
+    static const unsigned int executor_workers;
 
     // Defaults for logging service.
     static const std::string log_verbosity;
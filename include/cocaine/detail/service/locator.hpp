@@ -58,6 +58,10 @@ public:
 
     // Restricted services.
     std::set<std::string> restricted;
+
+    // Number of service updates remote locators are allowed to send ahead of this node processing
+    // them. Zero disables flow control for such streams.
+    std::uint64_t window;
 };
 
 class locator_t:
@@ -22,6 +22,7 @@
 #define COCAINE_ENGINE_HPP
 
 #include "cocaine/common.hpp"
+#include "cocaine/locked_ptr.hpp"
 
 #include <asio/deadline_timer.hpp>
 
@@ -37,6 +38,8 @@ class execution_unit_t {
 
     class gc_action_t;
 
+    struct options_t;
+
     // Connections
 
     std::map<int, std::shared_ptr<session_t>> m_sessions;
@@ -44,12 +47,24 @@ class execution_unit_t {
     // I/O
 
     std::shared_ptr<asio::io_service> m_asio;
+
+    // Serves the sessions instead of the reactor, if enabled and available.
+    std::shared_ptr<io::uring_t> m_uring;
+
     std::unique_ptr<io::chamber_t> m_chamber;
 
     // Initialized here because of the dependency on the io::chamber_t's thread ID.
     const std::unique_ptr<logging::logger_t> m_log;
+
+    // Parent of all the session logs. Shared, as sessions might outlive the engine.
+    const std::shared_ptr<logging::logger_t> m_session_log;
+
     metrics::registry_t& m_metrics;
 
+    // Per-service connection options, parsed from the configuration on the first connection to the
+    // service. Entries are never removed, so references to them stay valid.
+    mutable synchronized<std::map<std::string, std::unique_ptr<options_t>>> m_options;
+
     static const unsigned int kCollectionInterval = 60;
 
     // Collects detached sessions every kCollectionInterval seconds. Normally, session slots will be
@@ -59,17 +74,43 @@ class execution_unit_t {
     context_t& context;
 
 public:
-    explicit
-    execution_unit_t(context_t& context);
+    // The I/O thread is pinned to the specified CPUs, if any.
+    execution_unit_t(context_t& context, const cpuset_t& cpus);
 
    ~execution_unit_t();
 
+    // Sockets accepted on this unit's reactor are taken over as they are, others are cloned into it.
     template<class Socket>
     std::shared_ptr<session<typename Socket::protocol_type>>
     attach(std::unique_ptr<Socket> ptr, const io::dispatch_ptr_t& dispatch);
 
+    // Takes over the descriptor of a freshly accepted connection, which is closed on failure.
+    template<class Protocol>
+    std::shared_ptr<session<Protocol>>
+    attach(const Protocol& protocol, int fd, const io::dispatch_ptr_t& dispatch);
+
+    // Binds a new SO_REUSEPORT socket on the specified endpoint. Connections are accepted on this
+    // unit's reactor, so that they can be attached without any cross-thread handoff.
+    template<class Protocol>
+    std::unique_ptr<typename Protocol::acceptor>
+    expose(const typename Protocol::endpoint& endpoint);
+
     double
     utilization() const;
+
+private:
+    // Creates a session for the socket, which is already bound to this unit's reactor.
+    template<class Socket>
+    std::shared_ptr<session<typename Socket::protocol_type>>
+    launch(std::unique_ptr<Socket> ptr, const io::dispatch_ptr_t& dispatch);
+
+    // Returns per-service connection options from the configuration.
+    const options_t&
+    options(const std::string& service) const;
+
+    // Applies per-service connection options to a new session.
+    void
+    configure(session_t& session, const std::string& service) const;
 };
 
 } // namespace cocaine
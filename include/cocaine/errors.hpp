@@ -33,11 +33,14 @@ enum transport_errors {
     // TODO: maybe this should belong to protocol error, but it's here for backward compatibility
     hpack_error,
     insufficient_bytes,
-    parse_error
+    parse_error,
+    slow_consumer,
+    frame_too_large
 };
 
 enum protocol_errors {
-    closed_upstream = 1
+    closed_upstream = 1,
+    congested_upstream
 };
 
 enum dispatch_errors {
@@ -47,7 +50,8 @@ enum dispatch_errors {
     revoked_channel,
     slot_not_found,
     unbound_dispatch,
-    uncaught_error
+    uncaught_error,
+    refused_channel
 };
 
 enum repository_errors {
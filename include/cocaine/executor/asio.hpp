@@ -1,6 +1,7 @@
 #pragma once
 
 #include "cocaine/api/executor.hpp"
+#include "cocaine/cpuset.hpp"
 
 #include <asio/io_service.hpp>
 
@@ -21,6 +22,10 @@ public:
     // Choose wheteher to wait wor async operations completion in dtor or not
     owning_asio_t(stop_policy_t stop_policy = stop_policy_t::graceful);
 
+    // Pins the thread to the specified CPUs, usually the ones configured for executors.
+    explicit
+    owning_asio_t(const cpuset_t& cpus, stop_policy_t stop_policy = stop_policy_t::graceful);
+
     ~owning_asio_t();
 
     auto
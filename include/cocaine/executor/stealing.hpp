@@ -0,0 +1,85 @@
+#pragma once
+
+#include "cocaine/api/executor.hpp"
+#include "cocaine/cpuset.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace metrics {
+
+class registry_t;
+
+} // namespace metrics
+
+namespace cocaine {
+namespace executor {
+
+// Runs callbacks on a fixed pool of threads, for CPU-bound work which would otherwise block reactors.
+// Every worker has its own queue. Callbacks spawned by a worker go to its own queue, others are spread
+// over the queues round-robin. Workers take their own work newest first, and when out of it steal the
+// oldest work from the others.
+class stealing_t: public api::executor_t {
+public:
+    // Threads are pinned to the specified CPUs, if any.
+    explicit
+    stealing_t(std::size_t size, const cpuset_t& cpus = cpuset_t());
+
+    // Runs all the work spawned so far, including the work it spawns, before returning.
+    ~stealing_t();
+
+    using api::executor_t::spawn;
+
+    // Throws std::system_error once the executor is stopped, unless called from the work it runs.
+    auto
+    spawn(work_t work) -> void override;
+
+    // Waits for the threads to run out of work and exit, same as the destructor does. Idempotent.
+    auto
+    stop() -> void;
+
+    auto
+    size() const -> std::size_t;
+
+    // Publishes the queue depth, number of steals and completed callbacks as gauges named after the
+    // prefix. They stay valid after the executor is destroyed.
+    auto
+    publish(metrics::registry_t& hub, const std::string& prefix) -> void;
+
+private:
+    struct worker_t;
+    struct counters_t;
+
+    auto
+    run(std::size_t index) -> void;
+
+    // Takes the newest work from the worker's own queue, or the oldest work of some other worker.
+    auto
+    take(std::size_t index, work_t& work) -> bool;
+
+    const cpuset_t cpus;
+    const std::shared_ptr<counters_t> counters;
+
+    std::vector<std::unique_ptr<worker_t>> workers;
+    std::vector<std::thread> threads;
+
+    // Round-robin cursor for work spawned outside of the pool.
+    std::atomic<std::size_t> cursor;
+
+    // Idle workers wait here until there's some work or the executor is stopped.
+    std::mutex mutex;
+    std::condition_variable idle;
+    std::atomic<std::size_t> sleeping;
+    std::atomic<bool> stopping;
+
+    // Number of threads outside of the pool in the middle of spawning some work. Workers don't exit
+    // until these are done, so that the work is either rejected or run.
+    std::atomic<std::size_t> spawning;
+};
+
+} // namespace executor
+} // namespace cocaine
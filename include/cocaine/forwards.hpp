@@ -70,6 +70,7 @@ class tcp_actor_t;
 
 struct config_t;
 class context_t;
+class cpuset_t;
 class dynamic_t;
 class execution_unit_t;
 class port_mapping_t;
@@ -88,6 +89,7 @@ typedef unsigned short port_t;
 namespace cocaine { namespace api {
 
 class authentication_t;
+class executor_t;
 class repository_t;
 class unicorn_t;
 class unicorn_scope_t;
@@ -123,11 +125,11 @@ struct quote_t;
 namespace cocaine { namespace hpack {
 
 class header_t;
+class headers_t;
 struct headers;
 struct header_static_table;
 
 using header_storage_t __attribute__((deprecated("use `headers_t` instead"))) = std::vector<header_t>;
-using headers_t = std::vector<header_t>;
 
 }} // namespace cocaine::hpack
 
@@ -156,6 +158,8 @@ struct decoder_t;
 template<class, class = encoder_t, class = decoder_t>
 struct transport;
 
+class uring_t;
+
 // Generic RPC objects
 
 class basic_dispatch_t;
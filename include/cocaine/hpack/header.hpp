@@ -21,8 +21,11 @@
 #pragma once
 
 #include <array>
+#include <cstring>
 #include <deque>
 #include <functional>
+#include <initializer_list>
+#include <memory>
 #include <string>
 #include <system_error>
 #include <vector>
@@ -35,6 +38,7 @@ namespace cocaine { namespace hpack {
 
 struct init_header_t;
 class header_t;
+class headers_t;
 
 namespace header {
 
@@ -77,33 +81,6 @@ unpack(const std::string& from) {
     return *(reinterpret_cast<const To*>(from.c_str()));
 }
 
-boost::optional<const header_t&>
-find_first(const std::vector<header_t>& headers, const std::string& name);
-
-boost::optional<const header_t&>
-find_first(const std::vector<header_t>& headers, const char* name, size_t sz);
-
-template<size_t N>
-boost::optional<const header_t&>
-find_first(const std::vector<header_t>& headers, char const (&name)[N]) {
-    return find_first(headers, name, N - 1);
-}
-
-template<class Header>
-boost::optional<const header_t&>
-find_first(const std::vector<header_t>& headers) {
-    return find_first(headers, Header::name());
-}
-
-template <class To, class From>
-boost::optional<To>
-convert_first(const std::vector<header_t>& headers, From&& from) {
-    if(auto v = find_first(headers, from)) {
-        return boost::make_optional(unpack<To>(v->value()));
-    }
-    return boost::none;
-}
-
 } // namespace header
 
 struct headers;
@@ -111,9 +88,20 @@ struct headers;
 // Header class.
 class header_t {
 public:
-    header_t() = default;
+    header_t();
     header_t(std::string name, std::string value);
 
+    // Copies always own their data, even if the source header borrows it.
+    header_t(const header_t& other);
+
+    header_t&
+    operator=(const header_t& other);
+
+    header_t(header_t&&) = default;
+
+    header_t&
+    operator=(header_t&&) = default;
+
     // Create predefined header on user-provided data
     template<class Header>
     static
@@ -130,12 +118,27 @@ public:
         return header_t(Header::name(), Header::value());
     }
 
+    // Create header which value references external memory, like a message buffer, without copying
+    // it. Names of the static table headers are interned, other names are copied. The memory must
+    // stay valid while this header or any header moved from it is alive.
+    static
+    header_t
+    borrow(const char* name, size_t name_size, const char* value, size_t value_size);
+
     const std::string&
     name() const;
 
+    // NOTE: Borrowed values are copied into the header on first access, consider using value_data()
+    // and value_size() where it's enough.
     const std::string&
     value() const;
 
+    const char*
+    value_data() const;
+
+    size_t
+    value_size() const;
+
     bool
     operator==(const header_t& other) const;
 
@@ -147,14 +150,260 @@ public:
     http2_size() const;
 
 private:
-    struct {
-        std::string name;
-        std::string value;
-    } data;
+    // Either points to a static table header name or to the own name.
+    const std::string* interned;
+
+    std::string own_name;
+
+    mutable std::string own_value;
+
+    // Borrowed value, if any.
+    mutable const char* borrowed;
+    mutable size_t borrowed_size;
 };
 
-typedef std::vector<header_t> headers_t;
-using headers_t = std::vector<header_t>;
+// Header list with inline storage for the few headers most of the messages carry, so that building
+// it does not involve the allocator. Mimics the subset of std::vector interface and converts to and
+// from std::vector<header_t> for compatibility.
+class headers_t {
+public:
+    static constexpr size_t inline_capacity = 6;
+
+    typedef header_t value_type;
+    typedef header_t& reference;
+    typedef const header_t& const_reference;
+    typedef header_t* iterator;
+    typedef const header_t* const_iterator;
+    typedef size_t size_type;
+
+    headers_t();
+    headers_t(std::initializer_list<header_t> list);
+    headers_t(const std::vector<header_t>& other);
+
+    headers_t(const headers_t& other);
+    headers_t(headers_t&& other);
+
+   ~headers_t();
+
+    headers_t&
+    operator=(const headers_t& other);
+
+    headers_t&
+    operator=(headers_t&& other);
+
+    operator std::vector<header_t>() const;
+
+    iterator
+    begin() {
+        return ptr;
+    }
+
+    iterator
+    end() {
+        return ptr + length;
+    }
+
+    const_iterator
+    begin() const {
+        return ptr;
+    }
+
+    const_iterator
+    end() const {
+        return ptr + length;
+    }
+
+    size_t
+    size() const {
+        return length;
+    }
+
+    bool
+    empty() const {
+        return length == 0;
+    }
+
+    size_t
+    capacity() const {
+        return allocated;
+    }
+
+    header_t&
+    operator[](size_t idx) {
+        return ptr[idx];
+    }
+
+    const header_t&
+    operator[](size_t idx) const {
+        return ptr[idx];
+    }
+
+    header_t&
+    front() {
+        return ptr[0];
+    }
+
+    const header_t&
+    front() const {
+        return ptr[0];
+    }
+
+    header_t&
+    back() {
+        return ptr[length - 1];
+    }
+
+    const header_t&
+    back() const {
+        return ptr[length - 1];
+    }
+
+    void
+    reserve(size_t size);
+
+    void
+    push_back(const header_t& header) {
+        emplace_back(header);
+    }
+
+    void
+    push_back(header_t&& header) {
+        emplace_back(std::move(header));
+    }
+
+    template<class... Args>
+    void
+    emplace_back(Args&&... args) {
+        if(length == allocated) {
+            // The arguments might reference one of the headers being relocated.
+            header_t header(std::forward<Args>(args)...);
+            reserve(allocated * 2);
+            new(ptr + length) header_t(std::move(header));
+        } else {
+            new(ptr + length) header_t(std::forward<Args>(args)...);
+        }
+
+        length += 1;
+    }
+
+    void
+    pop_back();
+
+    iterator
+    erase(const_iterator position);
+
+    void
+    clear();
+
+private:
+    bool
+    is_inline() const;
+
+private:
+    header_t* ptr;
+    size_t length;
+    size_t allocated;
+
+    typename std::aligned_storage<sizeof(header_t), alignof(header_t)>::type buffer[inline_capacity];
+};
+
+bool
+operator==(const headers_t& lhs, const headers_t& rhs);
+
+bool
+operator!=(const headers_t& lhs, const headers_t& rhs);
+
+namespace header {
+
+template<class To>
+To
+unpack(const header_t& from) {
+    static_assert(std::is_pod<typename std::remove_reference<To>::type>::value &&
+                  !std::is_pointer<typename std::remove_reference<To>::type>::value &&
+                  !std::is_array<typename std::remove_reference<To>::type>::value,
+                  "only POD non pointer, non array data type is allowed to convert header data"
+    );
+    if(from.value_size() != sizeof(typename std::remove_reference<To>::type)) {
+        throw std::system_error(std::make_error_code(std::errc::invalid_argument), "invalid header data size");
+    }
+    typename std::remove_cv<typename std::remove_reference<To>::type>::type result;
+    std::memcpy(&result, from.value_data(), sizeof(result));
+    return result;
+}
+
+boost::optional<const header_t&>
+find_first(const std::vector<header_t>& headers, const std::string& name);
+
+boost::optional<const header_t&>
+find_first(const std::vector<header_t>& headers, const char* name, size_t sz);
+
+boost::optional<const header_t&>
+find_first(const headers_t& headers, const std::string& name);
+
+boost::optional<const header_t&>
+find_first(const headers_t& headers, const char* name, size_t sz);
+
+template<class Headers, size_t N>
+boost::optional<const header_t&>
+find_first(const Headers& headers, char const (&name)[N]) {
+    return find_first(headers, name, N - 1);
+}
+
+template<class Header, class Headers>
+boost::optional<const header_t&>
+find_first(const Headers& headers) {
+    return find_first(headers, Header::name());
+}
+
+template <class To, class Headers, class From>
+boost::optional<To>
+convert_first(const Headers& headers, From&& from) {
+    if(auto v = find_first(headers, from)) {
+        return boost::make_optional(unpack<To>(*v));
+    }
+    return boost::none;
+}
+
+} // namespace header
+
+namespace detail {
+
+// Open addressing hash index over header table entries. Every slot keeps a hash of the key and a
+// position of the entry in the table, keys themselves are compared by the caller via predicates.
+class header_index_t {
+public:
+    // Twice as many slots as the dynamic table can ever hold entries.
+    static constexpr size_t capacity = 256;
+
+    header_index_t();
+
+    // Returns the position of the entry satisfying the predicate or npos.
+    template<class Predicate>
+    size_t
+    find(size_t hash, Predicate predicate) const;
+
+    // Inserts the position or replaces the position of the entry with an equal key.
+    template<class Predicate>
+    void
+    insert(size_t hash, size_t position, Predicate predicate);
+
+    // Removes the given position, if it is still indexed.
+    void
+    erase(size_t hash, size_t position);
+
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+private:
+    struct slot_t {
+        uint32_t hash;
+        // Entry position plus one, zero for empty slots.
+        uint32_t position;
+    };
+
+    std::array<slot_t, capacity> slots;
+};
+
+} // namespace detail
 
 // Header static and dynamic table as described in http2
 // See https://tools.ietf.org/html/draft-ietf-httpbis-header-compression-12#section-2.3
@@ -168,17 +417,11 @@ public:
     void
     push(header_t header);
 
-    inline
     size_t
-    find_by_full_match(const header_t& header) {
-        return find(std::bind(&header_t::operator==, &header, std::placeholders::_1));
-    }
+    find_by_full_match(const header_t& header);
 
-    inline
     size_t
-    find_by_name(const header_t& header) {
-        return find(std::bind(&header_t::name_equal, &header, std::placeholders::_1));
-    }
+    find_by_name(const header_t& header);
 
     size_t
     data_size() const;
@@ -197,15 +440,34 @@ public:
     // 32 bytes overhead per record and 2 bytes for nil-nil header.
     static constexpr size_t max_header_capacity = max_data_capacity / (http2_header_overhead + 2);
 
+    // Even empty headers take the overhead bytes, so this is the hard limit for the entry count.
+    static constexpr size_t max_entries = max_data_capacity / http2_header_overhead;
+
 private:
     void
     pop();
 
+    // Dynamic table entry index for the given ring position.
     size_t
-    find(const std::function<bool(const header_t&)> comp);
+    index_of(size_t position) const;
+
+    // Dynamic part of the table, allocated on first push, because most of the tables are never
+    // used with compression enabled.
+    struct dynamic_t {
+        // Header storage. Implemented as a circular buffer, the oldest entry is at the tail.
+        std::array<header_t, max_entries> ring;
+
+        detail::header_index_t by_full_match;
+        detail::header_index_t by_name;
+    };
+
+    std::unique_ptr<dynamic_t> dynamic;
+
+    size_t tail;
+    size_t count;
 
-    // Header storage. Implemented as a circular buffer.
-    std::deque<header_t> headers;
+    // Total size of all the entries as defined by http2.
+    size_t total;
     size_t capacity;
 };
 
@@ -91,6 +91,37 @@ struct msgpack_traits {
         //packer.pack_raw_body(source.value().c_str(), source.value().size());
     }
 
+    // Pack a header using the dynamic table. Headers already present in the table are sent as an
+    // index, others are sent as literals with indexed names when possible and are stored in both
+    // encoder's and receiver's tables, unless they are too large to be worth it.
+    template<class Stream>
+    static
+    void
+    pack_compressed(msgpack::packer<Stream>& packer, header_table_t& table, const header_t& source) {
+        if(const size_t pos = table.find_by_full_match(source)) {
+            packer.pack(static_cast<uint64_t>(pos));
+            return;
+        }
+
+        // NOTE: Large headers would evict most of the table, so they are not indexed at all.
+        if(source.http2_size() * 2 > table.data_capacity()) {
+            return pack_unindexed(packer, table, source);
+        }
+
+        pack_literal(packer, table.find_by_name(source), true, source);
+        table.push(source);
+    }
+
+    // Pack a header as a literal which is not stored in the dynamic table. Meant for headers which
+    // values are unlikely to repeat, like span ids, so they do not evict useful table entries. The
+    // name is still referenced from the table if it's there.
+    template<class Stream>
+    static
+    void
+    pack_unindexed(msgpack::packer<Stream>& packer, header_table_t& table, const header_t& source) {
+        pack_literal(packer, table.find_by_name(source), false, source);
+    }
+
     template<class Stream>
     static
     void
@@ -104,6 +135,31 @@ struct msgpack_traits {
         packer.pack_raw_body(source.value().c_str(), source.value().size());
     }
 
+    template<class Stream>
+    static
+    void
+    pack_literal(msgpack::packer<Stream>& packer, size_t name_pos, bool store, const header_t& source) {
+        packer.pack_array(3);
+
+        // True flag means store header in dynamic_table on receiver side
+        if(store) {
+            packer.pack_true();
+        } else {
+            packer.pack_false();
+        }
+
+        if(name_pos) {
+            packer.pack(static_cast<uint64_t>(name_pos));
+        } else {
+            packer.pack_raw(source.name().size());
+            packer.pack_raw_body(source.name().c_str(), source.name().size());
+        }
+
+        packer.pack_raw(source.value().size());
+        packer.pack_raw_body(source.value().c_str(), source.value().size());
+    }
+
+    // NOTE: Literal values are borrowed from the message buffer instead of being copied.
     static inline
     header_t
     unpack(const msgpack::object& source, header_table_t& table) {
@@ -115,20 +171,20 @@ struct msgpack_traits {
             return table[source.via.u64];
         }
 
+        const auto& value = source.via.array.ptr[2];
+
+        header_t result;
+
         // Encode name to header
-        std::string header_name;
         if(source.via.array.ptr[1].type == msgpack::type::POSITIVE_INTEGER) {
-            header_name = table[source.via.array.ptr[1].via.u64].name();
+            const auto& name = table[source.via.array.ptr[1].via.u64].name();
+            result = header_t::borrow(name.data(), name.size(), value.via.raw.ptr, value.via.raw.size);
         } else {
-            header_name = std::string(source.via.array.ptr[1].via.raw.ptr, source.via.array.ptr[1].via.raw.size);
+            const auto& name = source.via.array.ptr[1].via.raw;
+            result = header_t::borrow(name.ptr, name.size, value.via.raw.ptr, value.via.raw.size);
         }
 
-        // Encode value to header
-        auto value = source.via.array.ptr[2];
-        std::string header_value(value.via.raw.ptr, value.via.raw.size);
-
         // We don't need to store header in the table
-        header_t result(header_name, header_value);
         if(!source.via.array.ptr[0].via.boolean) {
             return result;
         }
@@ -138,7 +194,7 @@ struct msgpack_traits {
 
     static inline
     bool
-    unpack_vector(const msgpack::object& source, header_table_t& table, std::vector<header_t>& target) {
+    unpack_vector(const msgpack::object& source, header_table_t& table, headers_t& target) {
         target.reserve(source.via.array.size);
         for (size_t i = 0; i < source.via.array.size; i++) {
             msgpack::object& obj = source.via.array.ptr[i];
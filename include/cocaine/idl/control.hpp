@@ -75,6 +75,24 @@ struct goaway {
     >::type argument_type;
 };
 
+/// The window update event grants the peer credit for sending that many more chunks into one of
+/// its streams. Streams are not flow controlled until the first window update for them is received,
+/// so peers which never send these events are not affected.
+struct window_update {
+    typedef control_tag tag;
+
+    static const char* alias() {
+        return "window_update";
+    }
+
+    typedef boost::mpl::list<
+        /// Channel the credit is granted for.
+        std::uint64_t,
+        /// Number of additional chunks the peer is allowed to send.
+        std::uint64_t
+    >::type argument_type;
+};
+
 }; // struct control
 
 template<>
@@ -87,7 +105,8 @@ struct protocol<control_tag> {
         control::revoke,
         control::settings,
         control::ping,
-        control::goaway
+        control::goaway,
+        control::window_update
         // TODO: To be added more, incomplete.
     >::type messages;
 
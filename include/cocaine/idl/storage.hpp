@@ -23,6 +23,8 @@
 
 #include "cocaine/rpc/protocol.hpp"
 
+#include "cocaine/traits/slice.hpp"
+
 #include <vector>
 namespace cocaine { namespace io {
 
@@ -67,8 +69,8 @@ struct write {
      /* Key. */
         std::string,
      /* Value. Typically, it should be serialized with msgpack, so that the future reader could
-        assume that it can be deserialized safely. */
-        std::string,
+        assume that it can be deserialized safely. Referenced right in the received frame. */
+        slice_t,
      /* Tag list. Imagine these are your indexes. */
         optional<std::vector<std::string>>
     >::type argument_type;
@@ -62,10 +62,12 @@ private:
     // after the authentication process completes successfully. Constant.
     io::dispatch_ptr_t m_prototype;
 
-    // I/O acceptor action. There is a separate thread to accept new connections. After a connection
-    // is accepted, it is assigned to a least busy thread from the main thread pool. Synchronized to
-    // allow concurrent observing and operations.
-    synchronized<std::shared_ptr<accept_action_t>> m_acceptor;
+    // I/O acceptor actions. By default, there is a single action running in a separate thread to
+    // accept new connections. After a connection is accepted, it is assigned to a least busy thread
+    // from the main thread pool. With SO_REUSEPORT enabled, there is an action per thread of the pool
+    // instead, accepting connections right onto it. Synchronized to allow concurrent observing and
+    // operations.
+    synchronized<std::vector<std::shared_ptr<accept_action_t>>> m_acceptors;
 
 public:
     actor_base(context_t& context, std::unique_ptr<io::basic_dispatch_t> prototype);
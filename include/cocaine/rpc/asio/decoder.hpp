@@ -28,6 +28,9 @@
 
 #include <msgpack/object.hpp>
 
+#include <array>
+#include <memory>
+
 namespace cocaine { namespace io {
 
 struct decoder_t;
@@ -49,6 +52,14 @@ struct decoded_message_t {
     auto
     headers() const -> const hpack::headers_t&;
 
+    // The buffer this message has been decoded from, if it's reference counted. Arguments and
+    // header values can reference it instead of being copied out.
+    auto
+    buffer() const -> const std::shared_ptr<const void>&;
+
+    void
+    attach(std::shared_ptr<const void> buffer);
+
     void
     clear();
 
@@ -57,6 +68,63 @@ private:
     // These objects keep references to message buffer in the Decoder.
     msgpack::object object;
     hpack::headers_t metadata;
+
+    std::shared_ptr<const void> owner;
+};
+
+// Resumable frame boundary scanner. Walks over MessagePack type headers without materializing any
+// objects, remembering where it stopped, so that a frame split across multiple socket reads is only
+// scanned once in total, instead of being reparsed from the very beginning on each new chunk.
+
+struct frame_scanner_t {
+    // Same as the default msgpack unpacker stack depth, frames nested deeper are rejected anyway.
+    static const size_t kMaxDepth = 32;
+
+    // Default upper bound of the frame size. Frames declaring larger elements are rejected as soon as
+    // their headers are seen, before anything is buffered for them.
+    static const size_t kFrameLimit = 256 * 1024 * 1024;
+
+    explicit
+    frame_scanner_t(size_t limit = kFrameLimit);
+
+    // Continues scanning the frame prefix of the given size. The frame must start at the beginning
+    // of the data and it must be the same frame that has been partially scanned before. Returns true
+    // when the whole frame is available, in which case its size can be obtained via size(). Frames
+    // which are known to exceed the limit fail with the frame_too_large error.
+    bool
+    scan(const char* data, size_t size, std::error_code& ec);
+
+    // Number of bytes of the current frame scanned so far.
+    auto
+    size() const -> size_t;
+
+    // The lower bound of the current frame size, as far as it can be told from the declared lengths
+    // of its elements seen so far.
+    auto
+    expected() const -> size_t;
+
+    // Number of container elements in the current frame scanned so far, i.e. the number of objects
+    // the unpacker is going to allocate in its zone for the whole frame.
+    auto
+    objects() const -> size_t;
+
+    void
+    reset();
+
+private:
+    bool
+    complete();
+
+private:
+    const size_t limit;
+
+    size_t offset;
+    size_t skip;
+    size_t nested;
+
+    // Number of elements yet to be scanned for every open container.
+    std::array<uint64_t, kMaxDepth> pending;
+    size_t depth;
 };
 
 } // namespace aux
@@ -64,16 +132,47 @@ private:
 struct decoder_t {
     COCAINE_DECLARE_NONCOPYABLE(decoder_t)
 
-    decoder_t() = default;
-   ~decoder_t() = default;
+    // Upper bound of the zone memory retained between frames. Frames requiring more than that are
+    // still decoded, but their zone chunks are released right after the next frame arrives.
+    static const size_t kZoneLimit = 256 * 1024;
+
+    // Number of consecutive frames fitting into the initial chunk, after which a grown zone is
+    // shrunk back, so that connections which have seen a few large frames don't keep the memory.
+    static const size_t kShrinkAfter = 64;
+
+    explicit
+    decoder_t(size_t zone_limit = kZoneLimit, size_t frame_limit = aux::frame_scanner_t::kFrameLimit);
+   ~decoder_t();
 
     typedef aux::decoded_message_t message_type;
 
+    // Decodes the frame at the beginning of the data. If the frame is incomplete, returns zero and
+    // sets the error to insufficient_bytes; the next call is expected to be made with the same frame
+    // prefix extended with newly received bytes, so that only these new bytes are scanned.
     size_t
     decode(const char* data, size_t size, message_type& message, std::error_code& ec);
 
+    // Minimal number of bytes required to complete the frame currently being decoded. It is based
+    // on declared element lengths and can be used to preallocate the read buffer in one go.
+    auto
+    expected() const -> size_t;
+
+    // Size of the zone memory retained between frames.
+    auto
+    retained() const -> size_t;
+
 private:
-    msgpack::zone zone;
+    // Clearing msgpack zone frees every chunk but the initial one, so the zone is recreated with a
+    // bigger initial chunk once frames stop fitting into it. Clearing then merely resets the bump
+    // pointer, and in the steady state the zone doesn't touch the heap at all.
+    std::unique_ptr<msgpack::zone> zone;
+    size_t zone_size;
+    const size_t zone_limit;
+
+    // Number of consecutive frames which would fit into the initial chunk.
+    size_t small_frames;
+
+    aux::frame_scanner_t scanner;
 
     // HPACK HTTP/2.0 tables.
     hpack::header_table_t hpack_context;
@@ -24,8 +24,12 @@
 #include "cocaine/hpack/header.hpp"
 #include "cocaine/memory.hpp"
 #include "cocaine/rpc/protocol.hpp"
+#include "cocaine/rpc/slice.hpp"
 #include "cocaine/traits/tuple.hpp"
 
+#include <array>
+#include <type_traits>
+
 namespace cocaine { namespace io {
 
 template<class Event>
@@ -35,36 +39,148 @@ struct encoder_t;
 
 namespace aux {
 
+// Recycles encoding buffers of a few fixed size classes, so that encoding messages in the steady state
+// doesn't hit the allocator. Not thread-safe, meant to be owned by a single encoder. As there is an
+// encoder per connection, idle buffers are kept sparingly.
+class buffer_pool_t {
+    COCAINE_DECLARE_NONCOPYABLE(buffer_pool_t)
+
+public:
+    // Size classes are powers of two from 256 bytes to 64 KB. Larger buffers are not pooled.
+    static const size_t kMinClassSize = 256;
+    static const size_t kClassCount = 9;
+
+    // The maximum number of idle buffers kept in the smallest size class, it is halved with every
+    // next class down to a single buffer.
+    static const size_t kMaxIdle = 16;
+
+    // The maximum total size of idle buffers.
+    static const size_t kMaxIdleBytes = 32768;
+
+    buffer_pool_t() = default;
+   ~buffer_pool_t();
+
+    // Returns a buffer of at least the specified size, actual capacity is written back.
+    char*
+    acquire(size_t& capacity);
+
+    void
+    release(char* data, size_t capacity);
+
+private:
+    std::array<std::vector<char*>, kClassCount> m_idle;
+
+    size_t m_idle_bytes = 0;
+};
+
 struct encoded_buffers_t {
     friend struct encoded_message_t;
 
     static const size_t kInitialBufferSize = 2048;
 
+    // Pinned payloads of at least this size are referenced instead of being copied.
+    static const size_t kReferenceThreshold = 4096;
+
     encoded_buffers_t();
 
+    // Takes the buffer from the pool, preallocating the specified number of bytes.
+    encoded_buffers_t(std::shared_ptr<buffer_pool_t> pool, size_t size);
+
+   ~encoded_buffers_t();
+
     // Movable
-    encoded_buffers_t(encoded_buffers_t&&) = default;
+    encoded_buffers_t(encoded_buffers_t&& other);
 
     encoded_buffers_t&
-    operator=(encoded_buffers_t&&) = default;
+    operator=(encoded_buffers_t&& other);
 
     COCAINE_DECLARE_NONCOPYABLE(encoded_buffers_t)
 
     void
     write(const char* data, size_t size);
 
+    // Marks the memory region as stable for the lifetime of the encoded message, so that if it's
+    // written as a whole later, it's referenced instead of being copied.
+    void
+    pin(const char* data, size_t size);
+
+    // Checks whether the pinned memory region starting at the specified address was referenced.
+    bool
+    referenced(const char* data) const;
+
+    // Keeps the owner of some referenced memory alive as long as the buffers.
+    void
+    retain(std::shared_ptr<const void> owner);
+
+    // Inline part of the encoded data, which is the whole data unless something was referenced.
     auto
     data() const -> const char*;
 
+    // Total size of the encoded data, including the referenced memory.
     size_t
     size() const;
 
+    bool
+    contiguous() const {
+        return segments.empty();
+    }
+
+    // Visits the encoded data chunks in order.
+    template<class F>
+    void
+    for_each(F&& visitor) const {
+        size_t position = 0;
+
+        for(auto it = segments.begin(); it != segments.end(); ++it) {
+            if(it->offset > position) {
+                visitor(buffer + position, it->offset - position);
+            }
+
+            visitor(it->data, it->size);
+            position = it->offset;
+        }
+
+        if(offset > position) {
+            visitor(buffer + position, offset - position);
+        }
+    }
+
 private:
-    std::vector<char, uninitialized<char>> vector;
-    std::vector<char, uninitialized<char>>::size_type offset;
+    void
+    reset();
+
+    std::shared_ptr<buffer_pool_t> pool;
+
+    char*  buffer;
+    size_t capacity;
+    size_t offset;
+
+    struct segment_t {
+        // Offset in the inline buffer the referenced memory is logically inserted at.
+        size_t offset;
+
+        const char* data;
+        size_t size;
+    };
+
+    struct pinned_t {
+        const char* data;
+        size_t size;
+        bool referenced;
+    };
+
+    // Referenced memory regions ordered by offset.
+    std::vector<segment_t> segments;
+    std::vector<pinned_t> pinned;
+
+    std::vector<std::shared_ptr<const void>> owners;
 };
 
 struct encoded_message_t {
+    encoded_message_t() = default;
+
+    encoded_message_t(std::shared_ptr<buffer_pool_t> pool, size_t size);
+
     void
     write(const char* data, size_t size);
 
@@ -74,6 +190,17 @@ struct encoded_message_t {
     size_t
     size() const;
 
+    bool
+    contiguous() const {
+        return buffer.contiguous();
+    }
+
+    template<class F>
+    void
+    for_each(F&& visitor) const {
+        buffer.for_each(std::forward<F>(visitor));
+    }
+
     encoded_buffers_t buffer;
 };
 
@@ -86,12 +213,147 @@ struct unbound_message_t {
     unbound_message_t(function_type&& bind_);
 };
 
+// Large string and slice arguments are referenced by encoded messages instead of being copied. Other
+// argument types are always copied.
+
+// String argument bound to an unbound message. Large strings are moved into a shared owner right away,
+// so that messages encoded from it can reference the string, while the argument itself stays intact
+// and can be encoded again, possibly by multiple encoders at once.
+class bound_string_t {
+public:
+    explicit
+    bound_string_t(std::string value) {
+        if(value.size() >= encoded_buffers_t::kReferenceThreshold) {
+            m_owner = std::make_shared<const std::string>(std::move(value));
+        } else {
+            m_value = std::move(value);
+        }
+    }
+
+    auto
+    get() const -> const std::string& {
+        return m_owner ? *m_owner : m_value;
+    }
+
+    auto
+    owner() const -> const std::shared_ptr<const std::string>& {
+        return m_owner;
+    }
+
+private:
+    std::string m_value;
+    std::shared_ptr<const std::string> m_owner;
+};
+
+// How arguments of the given type are stored in unbound messages.
+template<class T>
+struct bound {
+    typedef T type;
+};
+
+template<>
+struct bound<std::string> {
+    typedef bound_string_t type;
+};
+
+template<class T>
+inline
+auto
+unwrap(const T& value) -> const T& {
+    return value;
+}
+
+inline
+auto
+unwrap(const bound_string_t& value) -> const std::string& {
+    return value.get();
+}
+
+// Upper bounds of the encoded size of trivially sized arguments: scalars, strings and slices. Other
+// arguments would need a full packing pass to be measured, so a guess is made for them instead and
+// the buffer grows as needed.
+
+const size_t kEstimatedSize = 64;
+
+template<class T>
+inline
+size_t
+estimate(const T&, std::true_type) {
+    return 9;
+}
+
+template<class T>
+inline
+size_t
+estimate(const T&, std::false_type) {
+    return kEstimatedSize;
+}
+
+template<class T>
+inline
+size_t
+estimate(const T& value) {
+    return estimate(value, std::is_arithmetic<T>());
+}
+
+inline
+size_t
+estimate(const std::string& value) {
+    return 5 + value.size();
+}
+
+inline
+size_t
+estimate(const slice_t& value) {
+    return 5 + value.size();
+}
+
+template<class T>
+inline
+auto
+payload(const T&) -> std::pair<const char*, size_t> {
+    return std::make_pair(nullptr, 0);
+}
+
+inline
+auto
+payload(const std::string& value) -> std::pair<const char*, size_t> {
+    return std::make_pair(value.data(), value.size());
+}
+
+inline
+auto
+payload(const slice_t& value) -> std::pair<const char*, size_t> {
+    return std::make_pair(value.data(), value.size());
+}
+
+template<class T>
+inline
+void
+retain(encoded_buffers_t&, const T&) { }
+
+inline
+void
+retain(encoded_buffers_t& buffer, const bound_string_t& value) {
+    if(value.owner() && buffer.referenced(value.get().data())) {
+        buffer.retain(value.owner());
+    }
+}
+
+inline
+void
+retain(encoded_buffers_t& buffer, const slice_t& value) {
+    if(!value.empty() && buffer.referenced(value.data())) {
+        buffer.retain(value.owner());
+    }
+}
+
 } // namespace aux
 
 struct encoder_t {
     COCAINE_DECLARE_NONCOPYABLE(encoder_t)
 
-    encoder_t() = default;
+    encoder_t();
    ~encoder_t() = default;
 
     typedef aux::unbound_message_t message_type;
@@ -102,8 +364,38 @@ struct encoder_t {
     template<class Event, class... Args>
     static inline
     aux::encoded_message_t
-    tether(encoder_t& encoder, uint64_t channel_id, const hpack::headers_t& headers, Args&... args) {
-        aux::encoded_message_t message;
+    tether(encoder_t& encoder, uint64_t channel_id, const hpack::headers_t& headers, const Args&... args) {
+        typedef type_traits<typename event_traits<Event>::argument_type> traits_type;
+
+        // The buffer is sized upfront from the argument sizes, which are cheap to bound for scalars,
+        // strings and slices, and guessed for the rest. Headers can't be measured by packing, since it
+        // might modify the HPACK table, so they are estimated as well.
+        const size_t sizes[] = { aux::estimate(aux::unwrap(args))..., 0 };
+
+        size_t estimated = kArgumentsOverhead;
+
+        for(size_t size: sizes) {
+            estimated += size;
+        }
+
+        const std::pair<const char*, size_t> payloads[] = { aux::payload(aux::unwrap(args))..., { nullptr, 0 } };
+
+        size_t referenced = 0;
+
+        for(const auto& payload: payloads) {
+            if(payload.second >= aux::encoded_buffers_t::kReferenceThreshold) {
+                referenced += payload.second;
+            }
+        }
+
+        aux::encoded_message_t message(encoder.pool, kFrameOverhead + estimated - referenced +
+            estimate_headers(headers));
+
+        for(const auto& payload: payloads) {
+            if(payload.second >= aux::encoded_buffers_t::kReferenceThreshold) {
+                message.buffer.pin(payload.first, payload.second);
+            }
+        }
 
         packer_type packer(message.buffer);
 
@@ -116,10 +408,15 @@ struct encoder_t {
 
         // Message arguments
 
-        type_traits<typename event_traits<Event>::argument_type>::pack(packer,
-            std::forward<Args>(args)...);
+        traits_type::pack(packer, aux::unwrap(args)...);
 
         encoder.pack_headers(packer, headers);
+
+        if(referenced) {
+            const int expand[] = { (aux::retain(message.buffer, args), 0)..., 0 };
+            (void)expand;
+        }
+
         return message;
     }
 
@@ -129,9 +426,33 @@ struct encoder_t {
     void
     pack_headers(packer_type& packer, const hpack::headers_t& headers);
 
+    // Enables HPACK dynamic table indexing for outgoing headers. Disabled by default, because not
+    // all the clients are able to maintain the dynamic table on their side.
+    void
+    set_compression(bool enable);
+
+    auto
+    compressed() const -> bool;
+
 private:
+    // Frame array header, channel and message ids.
+    static const size_t kFrameOverhead = 1 + 9 + 9;
+
+    // Argument array header.
+    static const size_t kArgumentsOverhead = 5;
+
+    // Upper bound of the encoded headers size, including the tracing headers.
+    static
+    size_t
+    estimate_headers(const hpack::headers_t& headers);
+
     // HPACK HTTP/2.0 tables.
     hpack::header_table_t hpack_context;
+
+    // Encoded message buffers.
+    std::shared_ptr<aux::buffer_pool_t> pool;
+
+    bool compression = false;
 };
 
 template<class Event>
@@ -140,20 +461,20 @@ struct encoded:
 {
     template<class... Args>
     encoded(uint64_t channel_id, Args&&... args): unbound_message_t(
-    std::bind(&encoder_t::tether<Event, typename std::decay<Args>::type...>,
+    std::bind(&encoder_t::tether<Event, typename aux::bound<typename std::decay<Args>::type>::type...>,
               std::placeholders::_1,
               channel_id,
               hpack::headers_t(),
-              std::forward<Args>(args)...))
+              typename aux::bound<typename std::decay<Args>::type>::type(std::forward<Args>(args))...))
     { }
 
     template<class... Args>
     encoded(uint64_t channel_id, hpack::headers_t headers, Args&&... args): unbound_message_t(
-        std::bind(&encoder_t::tether<Event, typename std::decay<Args>::type...>,
+        std::bind(&encoder_t::tether<Event, typename aux::bound<typename std::decay<Args>::type>::type...>,
             std::placeholders::_1,
             channel_id,
             std::move(headers),
-            std::forward<Args>(args)...))
+            typename aux::bound<typename std::decay<Args>::type>::type(std::forward<Args>(args))...))
     { }
 };
 
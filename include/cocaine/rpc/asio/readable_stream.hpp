@@ -23,7 +23,10 @@
 
 #include "cocaine/errors.hpp"
 #include "cocaine/memory.hpp"
+#include "cocaine/rpc/asio/uring.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
 
 #include <asio/io_service.hpp>
@@ -41,6 +44,9 @@ class readable_stream:
 
     static const size_t kInitialBufferSize = 65536;
 
+    // Maximum factor the ring is grown by at once to fit a frame, based on its declared size.
+    static const size_t kMaxGrowth = 4;
+
     typedef typename Protocol::socket socket_type;
 
     typedef Decoder decoder_type;
@@ -50,64 +56,185 @@ class readable_stream:
 
     typedef std::function<void(const std::error_code&)> handler_type;
 
-    std::vector<char, uninitialized<char>> m_ring;
-    std::vector<char, uninitialized<char>>::size_type m_rd_offset, m_rx_offset;
+    typedef std::vector<char, uninitialized<char>> ring_type;
+
+    // NOTE: The ring is shared with decoded messages, so that their arguments can reference it.
+    std::shared_ptr<ring_type> m_ring;
+    ring_type::size_type m_rd_offset, m_rx_offset;
 
     decoder_type m_decoder;
 
+    // With io_uring, data is received continuously into the ring, regardless of whether somebody
+    // reads from the stream or not. The pending read, if any, is completed as soon as the message is
+    // received in full.
+
+    struct receiver_t:
+        public uring_t::operation_t
+    {
+        readable_stream* parent;
+
+        virtual
+        void
+        complete(int result, const char* data, bool more) {
+            parent->receive(result, data, more);
+        }
+
+        virtual
+        auto
+        active() const -> bool {
+            return !parent->m_cancelled;
+        }
+    };
+
+    const std::shared_ptr<uring_t> m_uring;
+    receiver_t m_receiver;
+
+    // Set while the receive is armed, keeps the stream alive until it's completed.
+    std::shared_ptr<readable_stream> m_armed;
+
+    message_type* m_message;
+    handler_type m_handle;
+
+    // Either the receive failed or the connection has been closed by the remote peer.
+    std::error_code m_error;
+
+    // Set once the transport is destroyed, might be observed from other threads.
+    std::atomic<bool> m_cancelled;
+
 public:
     explicit
-    readable_stream(const std::shared_ptr<socket_type>& socket):
-        m_socket(socket)
+    readable_stream(const std::shared_ptr<socket_type>& socket, std::shared_ptr<uring_t> uring = nullptr):
+        m_socket(socket),
+        m_ring(std::make_shared<ring_type>(kInitialBufferSize)),
+        m_uring(std::move(uring)),
+        m_message(nullptr),
+        m_cancelled(false)
     {
-        m_ring.resize(kInitialBufferSize);
         m_rd_offset = m_rx_offset = 0;
+        m_receiver.parent = this;
     }
 
     void
     read(message_type& message, handler_type handle) {
         std::error_code ec;
 
-        const size_t
-            bytes_pending = m_rd_offset - m_rx_offset,
-            bytes_decoded = m_decoder.decode(m_ring.data() + m_rx_offset, bytes_pending, message, ec);
+        if(read_buffered(message, ec)) {
+            return m_socket->get_io_service().post(std::bind(handle, ec));
+        }
 
-        if(ec != error::insufficient_bytes) {
-            if(!ec) {
-                m_rx_offset += bytes_decoded;
+        if(m_uring) {
+            if(m_error) {
+                return m_socket->get_io_service().post(std::bind(handle, m_error));
             }
 
-            return m_socket->get_io_service().post(std::bind(handle, ec));
-        }
+            m_message = &message;
+            m_handle = std::move(handle);
 
-        if(m_rx_offset) {
-            // Compactify the ring before the asynchronous read operation.
-            std::memmove(m_ring.data(), m_ring.data() + m_rx_offset, bytes_pending);
+            if(!m_armed) {
+                arm();
+            }
 
-            m_rd_offset = bytes_pending;
-            m_rx_offset = 0;
+            return;
         }
 
-        if(bytes_pending * 2 >= m_ring.size()) {
-            // The total size of unprocessed data in larger than half the size of the ring, so grow
-            // the ring in order to accomodate more data.
-            m_ring.resize(m_ring.size() * 2);
-        }
+        reserve(0);
 
         namespace ph = std::placeholders;
 
         m_socket->async_read_some(
-            asio::buffer(m_ring.data() + m_rd_offset, m_ring.size() - m_rd_offset),
+            asio::buffer(m_ring->data() + m_rd_offset, m_ring->size() - m_rd_offset),
             std::bind(&readable_stream::fill, this->shared_from_this(), std::ref(message), handle, ph::_1, ph::_2)
         );
     }
 
+    // Decodes the next message synchronously if it has been already received in full, without
+    // touching the socket. Returns false if more data has to be read first, otherwise the message
+    // is either decoded or the error code is set.
+    bool
+    read_buffered(message_type& message, std::error_code& ec) {
+        const size_t bytes_decoded = m_decoder.decode(
+            m_ring->data() + m_rx_offset,
+            m_rd_offset - m_rx_offset,
+            message,
+            ec
+        );
+
+        if(ec == error::insufficient_bytes) {
+            ec.clear();
+            return false;
+        }
+
+        if(!ec) {
+            m_rx_offset += bytes_decoded;
+            message.attach(m_ring);
+        }
+
+        return true;
+    }
+
     auto
     pressure() const -> size_t {
-        return m_ring.size();
+        return m_ring->size();
+    }
+
+    // Stops receiving data. Only does something with io_uring, as closing the socket is enough
+    // otherwise. Might be called from any thread.
+    void
+    cancel() {
+        // NOTE: Sockets moved into other transports are closed, and there's nothing to cancel.
+        if(m_uring && m_socket->is_open() && !m_cancelled.exchange(true)) {
+            m_socket->get_io_service().dispatch(std::bind(&readable_stream::abort, this->shared_from_this()));
+        }
     }
 
 private:
+    // Makes room in the ring for at least the specified number of bytes past the read offset.
+    void
+    reserve(size_t bytes_required) {
+        const size_t bytes_pending = m_rd_offset - m_rx_offset;
+
+        size_t ring_size = m_ring->size();
+
+        // NOTE: The decoder knows the declared lengths of the frame elements seen so far, so the ring
+        // can be grown to fit the whole frame at once instead of doubling it over multiple reads. The
+        // lengths are declared by the remote peer though, so the ring only grows by so much at once,
+        // until the data actually arrives.
+        const size_t bytes_expected = std::max(
+            std::min(m_decoder.expected(), ring_size * kMaxGrowth),
+            bytes_pending + bytes_required
+        );
+
+        if(bytes_expected > ring_size) {
+            ring_size = std::max(bytes_expected, ring_size * 2);
+        } else if(bytes_pending * 2 >= ring_size) {
+            // The total size of unprocessed data in larger than half the size of the ring, so grow
+            // the ring in order to accomodate more data.
+            ring_size *= 2;
+        }
+
+        if(!m_ring.unique() && (m_rx_offset || ring_size != m_ring->size())) {
+            // Some of the already decoded data is still referenced, so instead of compacting or
+            // reallocating the ring in place, move the pending data to a fresh one.
+            auto ring = std::make_shared<ring_type>(ring_size);
+
+            std::memcpy(ring->data(), m_ring->data() + m_rx_offset, bytes_pending);
+
+            m_ring = std::move(ring);
+            m_rd_offset = bytes_pending;
+            m_rx_offset = 0;
+        } else {
+            if(m_rx_offset) {
+                // Compactify the ring before the asynchronous read operation.
+                std::memmove(m_ring->data(), m_ring->data() + m_rx_offset, bytes_pending);
+
+                m_rd_offset = bytes_pending;
+                m_rx_offset = 0;
+            }
+
+            m_ring->resize(ring_size);
+        }
+    }
+
     void
     fill(message_type& message, handler_type handle, const std::error_code& ec, size_t bytes_read) {
         if(ec) {
@@ -122,6 +249,77 @@ private:
 
         read(std::ref(message), handle);
     }
+
+    void
+    arm() {
+        m_armed = this->shared_from_this();
+        m_uring->recv(m_socket->native_handle(), m_receiver);
+    }
+
+    void
+    receive(int result, const char* data, bool more) {
+        // Released on return, which might destroy the stream.
+        const std::shared_ptr<readable_stream> self = more ? nullptr : std::move(m_armed);
+
+        if(m_cancelled) {
+            return;
+        }
+
+        if(result > 0) {
+            if(m_ring->size() - m_rd_offset < static_cast<size_t>(result)) {
+                reserve(result);
+            }
+
+            std::memcpy(m_ring->data() + m_rd_offset, data, result);
+            m_rd_offset += result;
+        } else if(result == 0) {
+            m_error = asio::error::eof;
+        } else if(result != -ENOBUFS && result != -ECANCELED) {
+            // Running out of buffers or being paused just disarms the receive, see below.
+            m_error = std::error_code(-result, std::system_category());
+        }
+
+        if(!m_message) {
+            if(m_armed && m_rd_offset - m_rx_offset >= kInitialBufferSize) {
+                // Nobody reads from the stream, so stop receiving until the next read instead of
+                // buffering everything the remote peer sends.
+                m_uring->cancel(m_receiver);
+            }
+
+            return;
+        }
+
+        std::error_code ec;
+
+        if(!read_buffered(*m_message, ec)) {
+            if(!m_error) {
+                if(!m_armed) {
+                    arm();
+                }
+
+                return;
+            }
+
+            ec = m_error;
+        }
+
+        handler_type handle;
+
+        m_message = nullptr;
+        m_handle.swap(handle);
+
+        m_socket->get_io_service().post(std::bind(handle, ec));
+    }
+
+    void
+    abort() {
+        m_message = nullptr;
+        m_handle = nullptr;
+
+        if(m_armed) {
+            m_uring->cancel(m_receiver);
+        }
+    }
 };
 
 }} // namespace cocaine::io
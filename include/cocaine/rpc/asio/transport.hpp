@@ -36,37 +36,65 @@ struct transport {
     typedef Decoder  decoder_type;
     typedef typename protocol_type::socket socket_type;
 
+    // The socket is served by the io_uring instance instead of the reactor, if one is specified. It
+    // must belong to the same reactor as the socket.
     explicit
-    transport(std::unique_ptr<socket_type> socket_):
+    transport(std::unique_ptr<socket_type> socket_, std::shared_ptr<uring_t> uring_ = nullptr):
         socket(std::move(socket_)),
-        reader(new readable_stream<protocol_type, decoder_type>(socket)),
-        writer(new writable_stream<protocol_type, encoder_type>(socket))
+        uring(std::move(uring_)),
+        reader(new readable_stream<protocol_type, decoder_type>(socket, uring)),
+        writer(new writable_stream<protocol_type, encoder_type>(socket, uring))
     {
         socket->non_blocking(true);
     }
 
-    // Conversion constructor between transports with compatible underlying protocols.
+    // Conversion constructor between transports with compatible underlying protocols. Encoder settings
+    // are carried over, as transports are usually configured before being converted.
     template<class OtherProtocol>
     transport(transport<OtherProtocol, encoder_type, decoder_type>&& other):
         socket(new socket_type(std::move(*other.socket))),
-        reader(new readable_stream<protocol_type, decoder_type>(socket)),
-        writer(new writable_stream<protocol_type, encoder_type>(socket))
+        uring(other.uring),
+        reader(new readable_stream<protocol_type, decoder_type>(socket, uring)),
+        writer(new writable_stream<protocol_type, encoder_type>(socket, uring))
     {
         // The socket is already in non-blocking mode.
+        writer->encoder().set_compression(other.writer->encoder().compressed());
     }
 
    ~transport() {
+        reader->cancel();
+        writer->cancel();
+
         try {
             socket->shutdown(socket_type::shutdown_both);
-            socket->close();
         } catch(...) {
             // Might be already disconnected by the remote peer, so ignore all errors.
         }
+
+        if(uring) {
+            // NOTE: With io_uring, requests issued for the socket are submitted later on the reactor
+            // thread, where the streams drop them once cancelled. Closing the socket there as well
+            // makes sure its descriptor isn't reused by some other connection before that.
+            socket->get_io_service().dispatch(std::bind(&transport::close, socket));
+        } else {
+            close(socket);
+        }
+    }
+
+    static
+    void
+    close(const std::shared_ptr<socket_type>& socket) {
+        std::error_code ec;
+
+        // Errors are ignored for the same reason as above.
+        socket->close(ec);
     }
 
     // The underlying shared socket object.
     const std::shared_ptr<socket_type> socket;
 
+    const std::shared_ptr<uring_t> uring;
+
     // Unidirectional transport streams.
     const std::shared_ptr<readable_stream<protocol_type, decoder_type>> reader;
     const std::shared_ptr<writable_stream<protocol_type, encoder_type>> writer;
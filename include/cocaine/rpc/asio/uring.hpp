@@ -0,0 +1,125 @@
+/*
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_IO_URING_HPP
+#define COCAINE_IO_URING_HPP
+
+#include "cocaine/common.hpp"
+
+#include <sys/socket.h>
+
+namespace cocaine { namespace io {
+
+// Linux io_uring instance serving socket transports of a single reactor. Receives are multishot and
+// land in a ring of buffers provided to the kernel upfront, so that an idle connection costs nothing
+// and a busy one doesn't need to be rearmed after every read. All the requests issued during one
+// reactor turn are submitted with a single system call. Completions are delivered by the reactor,
+// which is woken up via an eventfd.
+//
+// NOTE: Not thread-safe, all the requests must be issued from the reactor thread.
+
+class uring_t:
+    public std::enable_shared_from_this<uring_t>
+{
+    COCAINE_DECLARE_NONCOPYABLE(uring_t)
+
+    struct state_t;
+
+    const std::unique_ptr<state_t> state;
+
+public:
+    // Submission queue size. The completion queue is four times bigger, as idle connections with
+    // an armed multishot receive don't occupy anything, while busy ones might produce a few
+    // completions per submission.
+    static const unsigned kEntries = 1024;
+
+    // Number and size of the receive buffers. Received data is copied out of them right away, so they
+    // only have to cover the completions reaped in one go.
+    static const unsigned kBuffers = 1024;
+    static const unsigned kBufferSize = 8192;
+
+    class operation_t {
+    public:
+        virtual
+       ~operation_t() { }
+
+        // Invoked for sends right before the request is submitted. The message has to stay valid
+        // until the request is completed.
+        virtual
+        auto
+        message() -> const msghdr*;
+
+        // Checked right before the request is submitted. Requests are only submitted on the next
+        // reactor turn, by which time the descriptor might have been closed and even reused by some
+        // other connection, so requests of the operations which are no longer needed are completed
+        // with ECANCELED instead.
+        virtual
+        auto
+        active() const -> bool;
+
+        // Invoked with the number of bytes transferred or a negated errno. Received data is only
+        // valid for the duration of the call. The request stays armed as long as more is set, the
+        // operation must not be destroyed or reused until then.
+        virtual
+        void
+        complete(int result, const char* data, bool more) = 0;
+    };
+
+    // Throws std::system_error if io_uring or some of its features used here are not available.
+    explicit
+    uring_t(asio::io_service& asio);
+
+   ~uring_t();
+
+    // Starts receiving into the provided buffers until the request is cancelled or fails.
+    void
+    recv(int fd, operation_t& operation);
+
+    void
+    send(int fd, operation_t& operation);
+
+    // Completes the armed request with ECANCELED, unless it's already completing.
+    void
+    cancel(operation_t& operation);
+
+    // Number of requests submitted and completions reaped so far.
+    auto
+    submissions() const -> std::uint64_t;
+
+    auto
+    completions() const -> std::uint64_t;
+
+private:
+    void
+    schedule(int opcode, int fd, operation_t* operation);
+
+    // Submits everything scheduled so far.
+    void
+    flush();
+
+    void
+    wait();
+
+    void
+    reap();
+};
+
+}} // namespace cocaine::io
+
+#endif
@@ -22,14 +22,20 @@
 #define COCAINE_IO_BUFFERED_WRITABLE_STREAM_HPP
 
 #include "cocaine/errors.hpp"
+#include "cocaine/rpc/asio/uring.hpp"
 #include "cocaine/trace/trace.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
 
 #include <asio/io_service.hpp>
 #include <asio/basic_stream_socket.hpp>
+#include <asio/deadline_timer.hpp>
 
+#include <cstring>
 #include <deque>
+#include <vector>
 
 namespace cocaine { namespace io {
 
@@ -52,42 +58,197 @@ class writable_stream:
     std::deque<typename Encoder::encoded_message_type> m_encoded_messages;
     std::deque<handler_type> m_handlers;
 
-    enum class states { idle, flushing } m_state;
+    // Handlers of the completed writes along with their results. They are invoked in batches, so that
+    // a burst of writes costs a single reactor post.
+    std::vector<std::pair<handler_type, std::error_code>> m_completed;
 
-    encoder_type encoder;
+    enum class states { idle, corked, flushing } m_state;
+
+    // Total size of the pending data. Atomic, since it might be observed from other threads.
+    std::atomic<size_t> m_bytes_pending;
+
+    // Pending data thresholds. The observer is notified when the high watermark is reached and when
+    // the pending data is drained down to the low watermark afterwards.
+    size_t m_low_watermark;
+    size_t m_high_watermark;
+    bool m_congested;
+
+    std::function<void(bool)> m_observer;
+
+    // Write coalescing thresholds, coalescing is disabled unless the byte threshold is set.
+    size_t m_cork_bytes;
+    boost::posix_time::time_duration m_cork_latency;
+
+    std::unique_ptr<asio::deadline_timer> m_cork_timer;
+
+    encoder_type m_encoder;
+
+    // With io_uring, instead of being written right away, pending messages are gathered into a single
+    // send request when the requests of the current reactor turn are submitted.
+
+    struct sender_t:
+        public uring_t::operation_t
+    {
+        writable_stream* parent;
+
+        std::vector<iovec> iovecs;
+        msghdr header;
+
+        virtual
+        auto
+        message() -> const msghdr* {
+            return parent->gather();
+        }
+
+        virtual
+        void
+        complete(int result, const char*, bool) {
+            parent->sent(result);
+        }
+
+        virtual
+        auto
+        active() const -> bool {
+            return !parent->m_cancelled;
+        }
+    };
+
+    // Linux doesn't accept more than this number of buffers in one go.
+    static const size_t kMaxBuffers = 1024;
+
+    const std::shared_ptr<uring_t> m_uring;
+    sender_t m_sender;
+
+    // Set while the send is in progress, keeps the stream alive until it's completed.
+    std::shared_ptr<writable_stream> m_sending;
+
+    // Set once the transport is destroyed, might be observed from other threads.
+    std::atomic<bool> m_cancelled;
 
 public:
     explicit
-    writable_stream(const std::shared_ptr<socket_type>& socket):
+    writable_stream(const std::shared_ptr<socket_type>& socket, std::shared_ptr<uring_t> uring = nullptr):
         m_socket(socket),
-        m_state(states::idle)
-    { }
+        m_state(states::idle),
+        m_bytes_pending(0),
+        m_low_watermark(0),
+        m_high_watermark(0),
+        m_congested(false),
+        m_cork_bytes(0),
+        m_uring(std::move(uring)),
+        m_cancelled(false)
+    {
+        m_sender.parent = this;
+    }
+
+    // NOTE: The handler might be empty, in which case nothing is called when the message is written.
+    // As all the messages are written in order and failures are reported to all the pending handlers,
+    // it is enough to only track the last message of a batch.
 
     void
     write(const message_type& message, handler_type handle) {
         size_t bytes_written = 0;
 
-        auto encoded = encoder.encode(message);
+        auto encoded = m_encoder.encode(message);
+
+        const bool immediate = m_state == states::idle && !m_cork_bytes && encoded.contiguous();
 
-        if(m_state == states::idle) {
+        if(immediate) {
             std::error_code ec;
 
             // Try to write some data right away, as we don't have anything pending.
-            bytes_written = m_socket->write_some(asio::buffer(encoded.data(), encoded.size()), ec);
+            bytes_written = write_some(asio::buffer(encoded.data(), encoded.size()), ec);
 
             if(!ec && bytes_written == encoded.size()) {
-                return m_socket->get_io_service().post(trace_t::bind(handle, ec));
+                return complete(handle, ec);
             }
         }
 
-        m_messages.emplace_back(encoded.data() + bytes_written, encoded.size() - bytes_written);
-        m_handlers.emplace_back(handle);
-        m_encoded_messages.emplace_back(std::move(encoded));
+        enqueue(std::move(encoded), bytes_written, std::move(handle));
 
         if(m_state == states::flushing) {
             return;
+        }
+
+        if(m_cork_bytes && m_bytes_pending < m_cork_bytes) {
+            if(m_state == states::idle) {
+                cork();
+            }
+
+            return;
+        }
+
+        if(m_state == states::corked || !immediate) {
+            // Either the coalescing threshold is reached or the message consists of multiple chunks,
+            // write everything at once.
+            return uncork();
+        }
+
+        m_state = states::flushing;
+
+        write_async();
+    }
+
+    // Enables write coalescing: instead of being written right away, messages are gathered until
+    // either the byte threshold is reached or the latency elapses, and then written with a single
+    // gather-write. With zero latency, messages written in the same reactor turn are coalesced.
+    // Zero byte threshold disables coalescing.
+    void
+    set_coalescing(size_t bytes, boost::posix_time::time_duration latency) {
+        m_cork_bytes = bytes;
+        m_cork_latency = latency;
+
+        if(m_cork_bytes && m_cork_latency > boost::posix_time::time_duration()) {
+            m_cork_timer.reset(new asio::deadline_timer(m_socket->get_io_service()));
         } else {
-            m_state = states::flushing;
+            m_cork_timer.reset();
+        }
+    }
+
+    // Disabled unless the high watermark is set. The observer is called with true when the stream
+    // becomes congested and with false when it's relieved.
+    void
+    set_watermarks(size_t low, size_t high, std::function<void(bool)> observer) {
+        m_low_watermark = std::min(low, high);
+        m_high_watermark = high;
+        m_observer = std::move(observer);
+    }
+
+    auto
+    pressure() const -> size_t {
+        return m_bytes_pending.load(std::memory_order_relaxed);
+    }
+
+    auto
+    encoder() -> encoder_type& {
+        return m_encoder;
+    }
+
+    // Abandons the pending data. Only does something with io_uring, as closing the socket is enough
+    // otherwise. Might be called from any thread.
+    void
+    cancel() {
+        m_cancelled = true;
+    }
+
+private:
+    template<class ConstBufferSequence>
+    size_t
+    write_some(const ConstBufferSequence& buffers, std::error_code& ec) {
+        if(m_uring) {
+            // Everything written during this reactor turn is going to be sent at once.
+            return 0;
+        }
+
+        return m_socket->write_some(buffers, ec);
+    }
+
+    void
+    write_async() {
+        if(m_uring) {
+            m_sending = this->shared_from_this();
+            m_uring->send(m_socket->native_handle(), m_sender);
+            return;
         }
 
         namespace ph = std::placeholders;
@@ -99,11 +260,130 @@ public:
     }
 
     auto
-    pressure() const -> size_t {
-        return asio::buffer_size(m_messages);
+    gather() -> const msghdr* {
+        auto& iovecs = m_sender.iovecs;
+
+        iovecs.clear();
+
+        for(auto it = m_messages.begin(); it != m_messages.end() && iovecs.size() < kMaxBuffers; ++it) {
+            iovecs.push_back({
+                const_cast<void*>(asio::buffer_cast<const void*>(*it)),
+                asio::buffer_size(*it)
+            });
+        }
+
+        std::memset(&m_sender.header, 0, sizeof(m_sender.header));
+
+        m_sender.header.msg_iov = iovecs.data();
+        m_sender.header.msg_iovlen = iovecs.size();
+
+        return &m_sender.header;
+    }
+
+    void
+    sent(int result) {
+        // Released on return, which might destroy the stream.
+        const std::shared_ptr<writable_stream> self = std::move(m_sending);
+
+        if(m_cancelled) {
+            return;
+        }
+
+        if(result < 0) {
+            flush(result == -ECANCELED ? asio::error::operation_aborted
+                                       : std::error_code(-result, std::system_category()), 0);
+        } else {
+            flush(std::error_code(), result);
+        }
+    }
+
+    void
+    enqueue(typename Encoder::encoded_message_type&& encoded, size_t bytes_written, handler_type handle) {
+        // Messages with referenced payloads consist of multiple chunks, each of which is queued as
+        // a separate buffer. Only the last one carries the handler and keeps the message alive.
+        encoded.for_each([&](const char* data, size_t size) {
+            if(bytes_written >= size) {
+                bytes_written -= size;
+                return;
+            }
+
+            m_messages.emplace_back(data + bytes_written, size - bytes_written);
+            m_handlers.emplace_back();
+            m_encoded_messages.emplace_back();
+
+            m_bytes_pending += size - bytes_written;
+            bytes_written = 0;
+        });
+
+        m_handlers.back() = std::move(handle);
+        m_encoded_messages.back() = std::move(encoded);
+
+        if(m_high_watermark && !m_congested && m_bytes_pending >= m_high_watermark) {
+            m_congested = true;
+            m_observer(true);
+        }
+    }
+
+    void
+    relieve() {
+        if(m_congested && m_bytes_pending <= m_low_watermark) {
+            m_congested = false;
+            m_observer(false);
+        }
+    }
+
+    void
+    cork() {
+        namespace ph = std::placeholders;
+
+        m_state = states::corked;
+
+        if(m_cork_timer) {
+            m_cork_timer->expires_from_now(m_cork_latency);
+            m_cork_timer->async_wait(std::bind(&writable_stream::expire, this->shared_from_this(), ph::_1));
+        } else {
+            // Everything written before this handler is invoked will be coalesced.
+            m_socket->get_io_service().post(std::bind(&writable_stream::expire, this->shared_from_this(),
+                std::error_code()));
+        }
+    }
+
+    void
+    uncork() {
+        if(m_cork_timer) {
+            m_cork_timer->cancel();
+        }
+
+        std::error_code ec;
+
+        // Write everything gathered so far at once.
+        const size_t bytes_written = write_some(m_messages, ec);
+
+        if(!ec) {
+            consume(bytes_written);
+        }
+
+        if(m_messages.empty()) {
+            m_state = states::idle;
+            return;
+        }
+
+        m_state = states::flushing;
+
+        write_async();
+    }
+
+    void
+    expire(const std::error_code& ec) {
+        // NOTE: The stream might have been already uncorked due to the byte threshold, and even corked
+        // again after that, in which case the messages are just written a bit earlier.
+        if(ec == asio::error::operation_aborted || m_state != states::corked) {
+            return;
+        }
+
+        uncork();
     }
 
-private:
     void
     flush(const std::error_code& ec, size_t bytes_written) {
         if(ec) {
@@ -112,16 +392,32 @@ private:
             }
 
             while(!m_handlers.empty()) {
-                m_socket->get_io_service().post(std::bind(m_handlers.front(), ec));
+                complete(m_handlers.front(), ec);
 
                 m_messages.pop_front();
                 m_handlers.pop_front();
                 m_encoded_messages.pop_front();
             }
 
+            m_bytes_pending = 0;
+
+            return relieve();
+        }
+
+        consume(bytes_written);
+
+        if(m_messages.empty() && m_state == states::flushing) {
+            m_state = states::idle;
             return;
         }
 
+        write_async();
+    }
+
+    void
+    consume(size_t bytes_written) {
+        m_bytes_pending -= bytes_written;
+
         while(bytes_written) {
             BOOST_ASSERT(!m_messages.empty() && !m_handlers.empty());
 
@@ -135,24 +431,39 @@ private:
             bytes_written -= message_size;
 
             // Queue this block's handler for invocation.
-            m_socket->get_io_service().post(std::bind(m_handlers.front(), ec));
+            complete(m_handlers.front(), std::error_code());
 
             m_messages.pop_front();
             m_handlers.pop_front();
             m_encoded_messages.pop_front();
         }
 
-        if(m_messages.empty() && m_state == states::flushing) {
-            m_state = states::idle;
+        relieve();
+    }
+
+    void
+    complete(handler_type& handle, const std::error_code& ec) {
+        if(!handle) {
             return;
         }
 
-        namespace ph = std::placeholders;
+        if(m_completed.empty()) {
+            m_socket->get_io_service().post(std::bind(&writable_stream::invoke, this->shared_from_this()));
+        }
 
-        m_socket->async_write_some(
-            m_messages,
-            std::bind(&writable_stream::flush, this->shared_from_this(), ph::_1, ph::_2)
-        );
+        m_completed.emplace_back(std::move(handle), ec);
+    }
+
+    void
+    invoke() {
+        std::vector<std::pair<handler_type, std::error_code>> completed;
+
+        // Handlers might issue new writes, which would be completed in the next batch.
+        completed.swap(m_completed);
+
+        for(auto it = completed.begin(); it != completed.end(); ++it) {
+            it->first(it->second);
+        }
     }
 };
 
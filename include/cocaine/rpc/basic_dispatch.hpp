@@ -28,6 +28,7 @@
 #include <boost/optional/optional_fwd.hpp>
 
 #include <string>
+#include <system_error>
 
 namespace cocaine {
 
@@ -60,6 +61,16 @@ public:
     boost::optional<dispatch_ptr_t>
     process(const decoder_t::message_type& message, const upstream_ptr_t& upstream) = 0;
 
+    // Same as the above, but reports the messages which can't be handled, e.g. unknown events or
+    // malformed arguments, via the error code instead of throwing. The default implementation just
+    // calls process() and lets its exceptions through, dispatches override it to reject such
+    // messages cheaply.
+
+    virtual
+    boost::optional<dispatch_ptr_t>
+    try_process(const decoder_t::message_type& message, const upstream_ptr_t& upstream,
+                std::error_code& ec);
+
     // Called on abnormal transport destruction. The idea's if the client disconnects unexpectedly,
     // i.e. not reaching the end of the dispatch graph, then some special handling might be needed.
     // Think 'zookeeper ephemeral nodes'.
@@ -80,6 +91,12 @@ public:
     virtual
     int
     version() const = 0;
+
+protected:
+    // Builds the exception for the message rejected by try_process(), so that process() can throw
+    // it. The event name, if it's known, is kept in the exception message along with the reason.
+    auto
+    rejection(int id, const std::error_code& ec) const -> std::system_error;
 };
 
 } // namespace io
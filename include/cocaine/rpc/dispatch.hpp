@@ -25,6 +25,7 @@
 #include "cocaine/hpack/header.hpp"
 #include "cocaine/locked_ptr.hpp"
 #include "cocaine/rpc/basic_dispatch.hpp"
+#include "cocaine/rpc/slice.hpp"
 #include "cocaine/rpc/slot/blocking.hpp"
 #include "cocaine/rpc/slot/deferred.hpp"
 #include "cocaine/rpc/slot/generic.hpp"
@@ -32,14 +33,19 @@
 #include "cocaine/rpc/traversal.hpp"
 #include "cocaine/traits/tuple.hpp"
 #include "cocaine/utility/exchange.hpp"
+#include "cocaine/utility/read_mostly.hpp"
 
+#include <boost/mpl/fold.hpp>
 #include <boost/mpl/transform.hpp>
 #include <boost/mpl/lambda.hpp>
 
+#include <boost/optional/optional.hpp>
+
 #include <boost/variant/apply_visitor.hpp>
 #include <boost/variant/static_visitor.hpp>
 #include <boost/variant/variant.hpp>
 
+#include <climits>
 #include <type_traits>
 #include <vector>
 
@@ -48,6 +54,31 @@ namespace cocaine {
 template<typename Event, typename = std::tuple<>>
 struct slot_builder;
 
+namespace aux {
+
+// Event ids of a protocol are dense, but don't necessarily start from zero, e.g. control events are
+// enumerated from the far end of the id space.
+
+template<int Lower, int Upper>
+struct id_range {
+    static const int lower = Lower;
+    static const int upper = Upper;
+};
+
+struct widen {
+    template<class Range, class Event>
+    struct apply {
+        static const int id = io::event_traits<Event>::id;
+
+        typedef id_range<
+            (id < Range::lower ? id : Range::lower),
+            (id > Range::upper ? id : Range::upper)
+        > type;
+    };
+};
+
+} // namespace aux
+
 template<class Tag>
 class dispatch:
     public io::basic_dispatch_t
@@ -63,12 +94,20 @@ class dispatch:
         >::type
     >::type slot_types;
 
-    typedef std::map<
-        int,
-        typename boost::make_variant_over<slot_types>::type
-    > slot_map_t;
+    typedef typename boost::make_variant_over<slot_types>::type slot_ptr_type;
+
+    typedef typename boost::mpl::fold<
+        typename io::messages<Tag>::type,
+        aux::id_range<INT_MAX, INT_MIN>,
+        aux::widen
+    >::type id_range;
+
+    // Slots are indexed by event id relative to the lowest one, unbound slots are empty. The table is
+    // replaced as a whole when dispatching after some modifications, so that it never takes a lock.
+    // Slots registered in a row, e.g. in the constructor, end up in the same copy of the table.
+    typedef std::vector<boost::optional<slot_ptr_type>> slot_table_t;
 
-    synchronized<slot_map_t> m_slots;
+    utility::read_mostly<slot_table_t> m_slots;
 
     // Slot traits
 
@@ -81,7 +120,8 @@ class dispatch:
 public:
     explicit
     dispatch(const std::string& name):
-        basic_dispatch_t(name)
+        basic_dispatch_t(name),
+        m_slots(id_range::upper >= id_range::lower ? id_range::upper - id_range::lower + 1 : 0)
     {}
 
     template<class Event>
@@ -108,6 +148,11 @@ public:
     boost::optional<io::dispatch_ptr_t>
     process(const io::decoder_t::message_type& message, const io::upstream_ptr_t& upstream);
 
+    virtual
+    boost::optional<io::dispatch_ptr_t>
+    try_process(const io::decoder_t::message_type& message, const io::upstream_ptr_t& upstream,
+                std::error_code& ec);
+
     virtual
     auto
     root() const -> const io::graph_root_t& {
@@ -125,6 +170,18 @@ public:
     template<class Visitor>
     auto
     process(int id, const Visitor& visitor) -> typename Visitor::result_type;
+
+private:
+    // Returns the slot bound to the event id, if any.
+    auto
+    find(int id) const -> boost::optional<slot_ptr_type>;
+
+    static
+    std::size_t
+    index(int id) {
+        // NOTE: Ids below the lowest one wrap around and end up out of the table bounds as well.
+        return static_cast<unsigned int>(id) - static_cast<unsigned int>(id_range::lower);
+    }
 };
 
 template<class Tag>
@@ -159,12 +216,16 @@ struct select<typename io::basic_slot<Event>::result_type, Event, ForwardMeta> {
 struct calling_visitor_t:
     public boost::static_visitor<boost::optional<io::dispatch_ptr_t>>
 {
-    calling_visitor_t(const std::vector<hpack::header_t>& headers_,
+    calling_visitor_t(const hpack::headers_t& headers_,
                       const msgpack::object& unpacked_,
-                      const io::upstream_ptr_t& upstream_):
+                      const std::shared_ptr<const void>& buffer_,
+                      const io::upstream_ptr_t& upstream_,
+                      std::error_code& ec_):
         headers(headers_),
         unpacked(unpacked_),
-        upstream(upstream_)
+        buffer(buffer_),
+        upstream(upstream_),
+        ec(ec_)
     { }
 
     template<class Event>
@@ -175,12 +236,20 @@ struct calling_visitor_t:
         // Unpacked arguments storage.
         typename slot_type::tuple_type args;
 
-        try {
+        {
+            // Slice arguments reference the message buffer instead of copying from it.
+            const io::slice_t::scope_t scope(buffer);
+
             // NOTE: Unpacks the object into a tuple using the argument typelist unlike using plain
             // tuple type traits, in order to support parameter tags, like optional<T>.
-            io::type_traits<typename io::event_traits<Event>::argument_type>::unpack(unpacked, args);
-        } catch(const msgpack::type_error& e) {
-            throw std::system_error(error::invalid_argument, e.what());
+            ec = io::flat_unpacker<typename io::event_traits<Event>::argument_type>::unpack(
+                unpacked,
+                args
+            );
+
+            if(ec) {
+                return boost::none;
+            }
         }
 
         // Call the slot with the upstream constrained with the event's upstream protocol type tag.
@@ -188,9 +257,11 @@ struct calling_visitor_t:
     }
 
 private:
-    const std::vector<hpack::header_t>& headers;
+    const hpack::headers_t& headers;
     const msgpack::object& unpacked;
+    const std::shared_ptr<const void>& buffer;
     const io::upstream_ptr_t& upstream;
+    std::error_code& ec;
 };
 
 /// Wraps the given slot of type `F` eating meta argument depending on `MetaFlag`.
@@ -328,9 +399,15 @@ dispatch<Tag>&
 dispatch<Tag>::on(const std::shared_ptr<io::basic_slot<Event>>& ptr) {
     typedef io::event_traits<Event> traits;
 
-    if(!m_slots->insert(std::make_pair(traits::id, ptr)).second) {
-        throw std::system_error(error::duplicate_slot, Event::alias());
-    }
+    m_slots.update([&](slot_table_t& table) {
+        auto& slot = table.at(index(traits::id));
+
+        if(slot) {
+            throw std::system_error(error::duplicate_slot, Event::alias());
+        }
+
+        slot = slot_ptr_type(ptr);
+    });
 
     return *this;
 }
@@ -346,46 +423,83 @@ template<class Tag>
 template<class Event>
 void
 dispatch<Tag>::drop() {
-    if(!m_slots->erase(io::event_traits<Event>::id)) {
-        throw std::system_error(error::slot_not_found, Event::alias());
-    }
+    m_slots.update([&](slot_table_t& table) {
+        auto& slot = table.at(index(io::event_traits<Event>::id));
+
+        if(!slot) {
+            throw std::system_error(error::slot_not_found, Event::alias());
+        }
+
+        slot = boost::none;
+    });
 }
 
 template<class Tag>
 void
 dispatch<Tag>::halt() {
-    m_slots->clear();
+    m_slots.update([&](slot_table_t& table) {
+        table.assign(table.size(), boost::none);
+    });
 }
 
 template<class Tag>
 boost::optional<io::dispatch_ptr_t>
 dispatch<Tag>::process(const io::decoder_t::message_type& message, const io::upstream_ptr_t& upstream) {
-    return process(message.type(), aux::calling_visitor_t(message.headers(), message.args(), upstream));
+    std::error_code ec;
+
+    const auto result = try_process(message, upstream, ec);
+
+    if(ec) {
+        throw rejection(message.type(), ec);
+    }
+
+    return result;
+}
+
+template<class Tag>
+boost::optional<io::dispatch_ptr_t>
+dispatch<Tag>::try_process(const io::decoder_t::message_type& message, const io::upstream_ptr_t& upstream,
+                           std::error_code& ec)
+{
+    const auto slot = find(message.type());
+
+    if(!slot) {
+        ec = error::slot_not_found;
+        return boost::none;
+    }
+
+    return boost::apply_visitor(aux::calling_visitor_t(
+        message.headers(), message.args(), message.buffer(), upstream, ec
+    ), *slot);
 }
 
 template<class Tag>
 template<class Visitor>
 typename Visitor::result_type
 dispatch<Tag>::process(int id, const Visitor& visitor) {
-    typedef typename slot_map_t::mapped_type slot_ptr_type;
+    const auto slot = find(id);
 
-    const auto slot = m_slots.apply([&](const slot_map_t& mapping) -> slot_ptr_type {
-        typename slot_map_t::const_iterator lb, ub;
+    if(!slot) {
+        throw std::system_error(error::slot_not_found);
+    }
 
-        // NOTE: Using equal_range() here, instead of find() to check for slot existence and get the
-        // slot pointer in one call instead of two.
-        std::tie(lb, ub) = mapping.equal_range(id);
+    return boost::apply_visitor(visitor, *slot);
+}
 
-        if(lb != ub) {
-            // NOTE: The slot pointer is copied here, allowing the handling code to unregister slots
-            // via dispatch<T>::forget() without pulling the object from underneath itself.
-            return lb->second;
+template<class Tag>
+auto
+dispatch<Tag>::find(int id) const -> boost::optional<slot_ptr_type> {
+    return m_slots.read([&](const slot_table_t& table) -> boost::optional<slot_ptr_type> {
+        const auto i = index(id);
+
+        // NOTE: The slot pointer is copied here, allowing the handling code to unregister slots via
+        // dispatch<T>::drop() without pulling the object from underneath itself.
+        if(i < table.size()) {
+            return table[i];
         } else {
-            throw std::system_error(error::slot_not_found);
+            return boost::none;
         }
     });
-
-    return boost::apply_visitor(visitor, slot);
 }
 
 } // namespace cocaine
@@ -25,6 +25,8 @@
 #include "cocaine/rpc/tags.hpp"
 #include "cocaine/rpc/upstream.hpp"
 
+#include <boost/optional/optional.hpp>
+
 #include <boost/variant/apply_visitor.hpp>
 #include <boost/variant/static_visitor.hpp>
 
@@ -58,17 +60,35 @@ private:
     hpack::headers_t& headers;
 };
 
+// Terminal messages close the channel, so they are never held back for the lack of credit.
+struct terminal_visitor:
+    public boost::static_visitor<bool>
+{
+    template<class Event>
+    bool
+    operator()(const frozen<Event>&) const {
+        return is_terminal<Event>::value;
+    }
+};
+
 } // namespace aux
 
 template<class Tag>
 class message_queue {
-    // Operation log.
-    std::vector<std::tuple<hpack::headers_t, typename make_frozen_over<Tag>::type>> m_operations;
+    typedef std::tuple<hpack::headers_t, typename make_frozen_over<Tag>::type> operation_type;
+
+    // Operation log. Contains the messages appended before the upstream is attached and the ones held
+    // back for the lack of credit.
+    std::vector<operation_type> m_operations;
 
     // The upstream might be attached during message invocation, so it has to be synchronized for
     // thread safety - the atomicity guarantee of the shared_ptr<T> is not enough.
     std::shared_ptr<basic_upstream_t> m_upstream;
 
+    // Number of non-terminal messages the remote peer is ready to accept. Unlimited until the peer
+    // grants some credit for the first time, see grant().
+    boost::optional<std::uint64_t> m_credit;
+
 public:
     template<class Event, class... Args>
     std::error_code
@@ -76,13 +96,14 @@ public:
         static_assert(std::is_same<typename Event::tag, Tag>::value,
                       "message protocol is not compatible with this message queue");
 
-        if(!m_upstream) {
+        if(!m_upstream || !admits<Event>()) {
             m_operations.emplace_back(std::move(headers), make_frozen<Event>(std::forward<Args>(args)...));
             return {};
         }
 
         try {
             m_upstream->template send<Event>(std::move(headers), std::forward<Args>(args)...);
+            consume<Event>();
             return {};
         } catch (const std::system_error& e) {
             return e.code();
@@ -92,16 +113,44 @@ public:
     template<class Event, class... Args>
     std::error_code
     append(Args&&... args) {
-        static_assert(std::is_same<typename Event::tag, Tag>::value,
-                      "message protocol is not compatible with this message queue");
+        return append<Event>(hpack::headers_t(), std::forward<Args>(args)...);
+    }
+
+    /// The queue is always writable until the upstream is attached, as messages are just logged.
+    bool
+    writable() const {
+        return !starved() && (!m_upstream || m_upstream->writable());
+    }
+
+    /// Checks whether the remote peer has used up all the credit it granted.
+    bool
+    starved() const {
+        return m_credit && *m_credit == 0;
+    }
+
+    /// Checks whether some messages are logged or held back, waiting for the upstream or credit.
+    bool
+    pending() const {
+        return !m_operations.empty();
+    }
+
+    auto
+    upstream() const -> std::shared_ptr<basic_upstream_t> {
+        return m_upstream;
+    }
+
+    /// Switches the queue to the flow controlled mode, if not already, and allows it to send this
+    /// many more non-terminal messages. The messages held back are sent right away, if possible.
+    std::error_code
+    grant(std::uint64_t increment) {
+        m_credit = m_credit.get_value_or(0) + increment;
 
         if(!m_upstream) {
-            m_operations.emplace_back(hpack::headers_t(), make_frozen<Event>(std::forward<Args>(args)...));
             return {};
         }
 
         try {
-            m_upstream->template send<Event>(std::forward<Args>(args)...);
+            flush();
             return {};
         } catch (const std::system_error& e) {
             return e.code();
@@ -116,19 +165,55 @@ public:
         static_assert(details::is_compatible<Tag, OtherTag>::value,
                       "upstream protocol is not compatible with this message queue");
 
-        if(!m_operations.empty()) {
+        m_upstream = std::move(upstream.ptr);
 
-            // For some weird reasons, boost::apply_visitor() only accepts lvalue-references to the
-            // visitor object, so there's no other choice but to actually bind it to a variable.
-            for (auto& operation : m_operations) {
-                aux::frozen_visitor visitor(upstream.ptr, std::get<0>(operation));
-                boost::apply_visitor(visitor, std::get<1>(operation));
-            }
+        flush();
+    }
+
+private:
+    template<class Event>
+    bool
+    admits() const {
+        // NOTE: Messages are never reordered, so nothing is sent while something is held back.
+        return m_operations.empty() && (is_terminal<Event>::value || !starved());
+    }
+
+    template<class Event>
+    void
+    consume() {
+        if(m_credit && !is_terminal<Event>::value) {
+            --*m_credit;
+        }
+    }
+
+    void
+    flush() {
+        auto it = m_operations.begin();
+
+        aux::terminal_visitor terminal;
 
+        try {
+            for(; it != m_operations.end(); ++it) {
+                if(!boost::apply_visitor(terminal, std::get<1>(*it))) {
+                    if(starved()) {
+                        break;
+                    } else if(m_credit) {
+                        --*m_credit;
+                    }
+                }
+
+                // For some weird reasons, boost::apply_visitor() only accepts lvalue-references to
+                // the visitor object, so there's no other choice but to actually bind it to a variable.
+                aux::frozen_visitor visitor(m_upstream, std::get<0>(*it));
+                boost::apply_visitor(visitor, std::get<1>(*it));
+            }
+        } catch(...) {
+            // The upstream is unusable at this point, so there's no point in keeping anything.
             m_operations.clear();
+            throw;
         }
 
-        m_upstream = std::move(upstream.ptr);
+        m_operations.erase(m_operations.begin(), it);
     }
 };
 
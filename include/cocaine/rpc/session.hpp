@@ -23,10 +23,14 @@
 
 #include <asio/generic/stream_protocol.hpp>
 
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
 #include "cocaine/common.hpp"
 #include "cocaine/locked_ptr.hpp"
 #include "cocaine/rpc/asio/decoder.hpp"
 #include "cocaine/rpc/asio/encoder.hpp"
+#include "cocaine/utility/flat_id_map.hpp"
+#include "cocaine/utility/mpsc_queue.hpp"
 
 namespace cocaine {
 
@@ -39,17 +43,26 @@ class session_t:
     typedef io::transport<protocol_type> transport_type;
 
     class pull_action_t;
-    class push_action_t;
 
     struct channel_t;
+    struct outgoing_t;
+
+    class channel_pool_t;
+    class control_dispatch_t;
+    class refused_dispatch_t;
 
-    typedef std::map<uint64_t, std::shared_ptr<channel_t>> channel_map_t;
+    typedef utility::flat_id_map<std::shared_ptr<channel_t>> channel_map_t;
+    typedef std::map<uint64_t, std::function<void(std::uint64_t)>> window_map_t;
 
     // Log of last resort.
     const std::unique_ptr<logging::logger_t> log;
 
+    // Shared by all the sessions of the service.
     struct metrics_t;
-    std::unique_ptr<metrics_t> metrics;
+    std::shared_ptr<metrics_t> metrics;
+
+    // The reactor of the underlying connection.
+    asio::io_service& reactor;
 
     // The underlying connection.
 #if defined(__clang__)
@@ -58,12 +71,16 @@ class session_t:
     synchronized<std::shared_ptr<transport_type>> transport;
 #endif
 
+    // Allows to reject outgoing messages without locking the transport.
+    std::atomic<bool> detached;
+
     // Initial dispatch. Internally synchronized.
     const io::dispatch_ptr_t prototype;
-    io::dispatch_ptr_t service_dispatch;
 
-    // Virtual channels.
+    // Virtual channels and their upstreams, allocated from the pools.
     synchronized<channel_map_t> channels;
+    const std::shared_ptr<channel_pool_t> pool;
+    const std::shared_ptr<channel_pool_t> upstream_pool;
 
     // The maximum channel id processed by the session. Checking whether channel id is always higher
     // than the previous channel id is similar to an infinite TIME_WAIT timeout for TCP sockets. It
@@ -71,6 +88,33 @@ class session_t:
     // ports available to us, it's good enough.
     uint64_t max_channel_id;
 
+    // The maximum number of already received messages handled in one reactor turn.
+    std::size_t budget;
+
+    // The maximum number of outgoing messages written in one reactor turn.
+    std::size_t batch;
+
+    // Outgoing messages, pushed from any thread and written by the reactor thread in batches. At most
+    // one flush is scheduled at any moment, which is indicated by the flag.
+    utility::mpsc_queue<outgoing_t> outgoing;
+    std::atomic<bool> flushing;
+
+    // The session is disconnected once it has more than this number of bytes pending to be written.
+    std::size_t write_limit;
+
+    // Whether the outgoing data has reached the high watermark and is not drained yet, along with
+    // the callbacks waiting for it to be drained.
+    std::atomic<bool> congested;
+    synchronized<std::vector<std::function<void()>>> waiters;
+
+    // The message pump is paused while the session is congested. New channels over the limit are
+    // refused, while the existing ones are served as usual, so that clients are able to close them.
+    std::size_t max_channels;
+    synchronized<std::shared_ptr<pull_action_t>> paused;
+
+    // Handlers for the credit granted by the remote peer to flow controlled outgoing streams.
+    synchronized<window_map_t> windows;
+
 public:
     session_t(std::unique_ptr<logging::logger_t> log,
               metrics::registry_t& metrics_hub,
@@ -93,11 +137,50 @@ public:
     auto
     remote_endpoint() const -> endpoint_type;
 
+    // Checks whether the outgoing data is below the high watermark, so that more messages can be
+    // pushed without growing the memory footprint.
+    bool
+    writable() const;
+
     // Modifiers
 
+    // Invokes the callback as soon as the session becomes writable, which might be right away. The
+    // callback is also invoked when the session is detached.
+    void
+    on_writable(std::function<void()> callback);
+
     auto
     fork(const io::dispatch_ptr_t& dispatch) -> io::upstream_ptr_t;
 
+    // Invokes the handler with the credit the remote peer grants for the specified channel, see the
+    // control::window_update event. An empty handler stops listening for window updates.
+    void
+    on_window_update(uint64_t id, std::function<void(std::uint64_t)> handler);
+
+    // Allows the remote peer to send this many more chunks into the specified channel.
+    void
+    grant(uint64_t id, std::uint64_t increment);
+
+    void
+    set_budget(std::size_t budget);
+
+    void
+    set_batch(std::size_t batch);
+
+    // Coalesces outgoing messages into larger writes, see writable_stream::set_coalescing().
+    void
+    set_coalescing(std::size_t bytes, boost::posix_time::time_duration latency);
+
+    // Sessions become non-writable at the high watermark and writable again once the outgoing data
+    // drains to the low watermark. Sessions above the limit are disconnected. Zeros disable both.
+    void
+    set_watermarks(std::size_t low, std::size_t high, std::size_t limit);
+
+    // Refuses new channels while the session has this many channels open, revoking them with the
+    // refused_channel error. Zero means no limit.
+    void
+    set_max_channels(std::size_t limit);
+
     void
     pull();
 
@@ -113,9 +196,42 @@ public:
     detach(const std::error_code& ec);
 
 private:
-    void
+    // Returns an error if the message has been rejected, e.g. for the lack of a slot to handle it,
+    // malformed arguments or a revoked channel. Exceptions thrown by slots are propagated as is.
+    std::error_code
     handle(const io::decoder_t::message_type& message);
 
+    void
+    flush();
+
+    void
+    send(const std::shared_ptr<transport_type>& ptr, const outgoing_t& outgoing,
+         std::function<void(const std::error_code&)> handle);
+
+    void
+    sent(const std::error_code& ec);
+
+    void
+    congest(bool value);
+
+    // Read-side flow control.
+
+    bool
+    saturated() const;
+
+    bool
+    pause(const std::shared_ptr<pull_action_t>& action);
+
+    void
+    resume();
+
+    void
+    update_window(uint64_t id, std::uint64_t increment);
+
+    // Tells the remote peer that the channel it has opened is over the limit.
+    void
+    refuse(uint64_t id);
+
     auto
     extract_trace(const io::decoder_t::message_type& message) const -> boost::optional<trace_t>;
 
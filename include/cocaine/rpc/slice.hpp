@@ -0,0 +1,110 @@
+/*
+    Copyright (c) 2011-2016 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_IO_SLICE_HPP
+#define COCAINE_IO_SLICE_HPP
+
+#include <memory>
+#include <string>
+
+namespace cocaine { namespace io {
+
+// Read-only reference counted view of a contiguous memory region, usually a part of a received
+// frame. Slots can declare slice arguments to get large payloads without copying them out of the
+// read buffer, in which case the buffer stays alive as long as any of the slices referencing it.
+
+class slice_t {
+public:
+    slice_t();
+    slice_t(std::shared_ptr<const void> owner, const char* data, size_t size);
+
+    // Owning slice over the string. Implicit, so that strings can be passed where slices expected.
+    slice_t(std::string value);
+
+    auto
+    data() const -> const char* {
+        return m_data;
+    }
+
+    auto
+    size() const -> size_t {
+        return m_size;
+    }
+
+    bool
+    empty() const {
+        return m_size == 0;
+    }
+
+    // The object keeping the referenced memory alive, if any.
+    auto
+    owner() const -> const std::shared_ptr<const void>& {
+        return m_owner;
+    }
+
+    auto
+    begin() const -> const char* {
+        return m_data;
+    }
+
+    auto
+    end() const -> const char* {
+        return m_data + m_size;
+    }
+
+    // Copies the referenced memory, it's implicit for compatibility with handlers accepting strings.
+    operator std::string() const;
+
+    auto
+    to_string() const -> std::string;
+
+    bool
+    operator==(const slice_t& other) const;
+
+    bool
+    operator!=(const slice_t& other) const;
+
+    // Binds slices unpacked on the current thread within the scope to the buffer being unpacked,
+    // so that they reference the buffer instead of copying the data. Slices unpacked outside of any
+    // scope own a copy of their data, as nothing is known about the unpacked object lifetime.
+    class scope_t {
+    public:
+        explicit
+        scope_t(const std::shared_ptr<const void>& owner);
+
+       ~scope_t();
+
+        static
+        auto
+        current() -> const std::shared_ptr<const void>*;
+
+    private:
+        const std::shared_ptr<const void>* m_previous;
+    };
+
+private:
+    std::shared_ptr<const void> m_owner;
+
+    const char* m_data;
+    size_t m_size;
+};
+
+}} // namespace cocaine::io
+
+#endif
@@ -21,6 +21,7 @@
 #ifndef COCAINE_IO_SLOT_HPP
 #define COCAINE_IO_SLOT_HPP
 
+#include "cocaine/hpack/header.hpp"
 #include "cocaine/rpc/protocol.hpp"
 
 #include "cocaine/tuple.hpp"
@@ -40,7 +41,7 @@ class basic_slot {
 
 public:
     // Expected dispatch, parameter and upstream types.
-    typedef std::vector<hpack::header_t> meta_type;
+    typedef hpack::headers_t meta_type;
     typedef typename traits_type::tuple_type tuple_type;
     typedef typename traits_type::sequence_type sequence_type;
     typedef dispatch<typename traits_type::dispatch_type> dispatch_type;
@@ -50,7 +50,7 @@ struct blocking_slot:
 
     virtual
     boost::optional<std::shared_ptr<dispatch_type>>
-    operator()(const std::vector<hpack::header_t>& headers,
+    operator()(const hpack::headers_t& headers,
                tuple_type&& args,
                upstream_type&& upstream)
     {
@@ -91,7 +91,7 @@ struct blocking_slot<Event, ForwardMeta, void>:
 
     virtual
     boost::optional<std::shared_ptr<dispatch_type>>
-    operator()(const std::vector<hpack::header_t>& headers,
+    operator()(const hpack::headers_t& headers,
                tuple_type&& args,
                upstream_type&& upstream)
     {
@@ -117,7 +117,7 @@ struct blocking_slot<Event, ForwardMeta, void>:
 // Blocking slot specialization for functions, that returns only additional headers.
 
 // template<class Event, class ForwardMeta>
-// struct blocking_slot<Event, ForwardMeta, std::vector<hpack::header_t>>:
+// struct blocking_slot<Event, ForwardMeta, hpack::headers_t>:
 
 // Blocking slot specialization for functions, that returns additional headers as like as args.
 
@@ -145,7 +145,7 @@ struct blocking_slot<Event, ForwardMeta, mute_slot_tag>:
 
     virtual
     boost::optional<std::shared_ptr<dispatch_type>>
-    operator()(const std::vector<hpack::header_t>& headers,
+    operator()(const hpack::headers_t& headers,
                tuple_type&& args,
                upstream_type&&)
     {
@@ -51,7 +51,7 @@ struct deferred_slot:
 
     virtual
     boost::optional<std::shared_ptr<dispatch_type>>
-    operator()(const std::vector<hpack::header_t>& headers,
+    operator()(const hpack::headers_t& headers,
                tuple_type&& args,
                upstream_type&& upstream)
     {
@@ -132,6 +132,22 @@ struct deferred_base {
         return outbox->synchronize()->template append<typename protocol::value>(std::move(headers), std::forward<Args>(args)...);
     }
 
+    bool
+    writable() const {
+        return outbox->synchronize()->writable();
+    }
+
+    // Invokes the callback once the client has consumed enough of the pending data, which might
+    // happen right away.
+    void
+    on_writable(std::function<void()> callback) {
+        if(const auto upstream = outbox->synchronize()->upstream()) {
+            upstream->on_writable(std::move(callback));
+        } else {
+            callback();
+        }
+    }
+
     template<class UpstreamType>
     void
     attach(UpstreamType&& upstream) {
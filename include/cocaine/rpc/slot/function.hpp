@@ -71,7 +71,7 @@ struct call_helper;
 template<class R>
 struct call_helper<R, std::true_type> {
     template<typename F, typename Args>
-    static auto apply(F fn, const std::vector<hpack::header_t>& meta, Args&& args) -> R {
+    static auto apply(F fn, const hpack::headers_t& meta, Args&& args) -> R {
         return tuple::invoke(std::tuple_cat(std::forward_as_tuple(meta), std::move(args)), fn);
     }
 };
@@ -79,7 +79,7 @@ struct call_helper<R, std::true_type> {
 template<class R>
 struct call_helper<R, std::false_type> {
     template<typename F, typename Args>
-    static auto apply(F fn, const std::vector<hpack::header_t>&, Args&& args) -> R {
+    static auto apply(F fn, const hpack::headers_t&, Args&& args) -> R {
         return tuple::invoke(std::move(args), fn);
     }
 };
@@ -92,7 +92,7 @@ struct reconstruct_function<R, std::true_type, std::tuple<Args...>> {
     typedef typename reconstruct_function<
         R,
         std::false_type,
-        std::tuple<const std::vector<hpack::header_t>&, Args...>
+        std::tuple<const hpack::headers_t&, Args...>
     >::type type;
 };
 
@@ -130,7 +130,7 @@ struct function_slot:
     {}
 
     R
-    call(const std::vector<hpack::header_t>& meta, tuple_type&& args) const {
+    call(const hpack::headers_t& meta, tuple_type&& args) const {
         return aux::call_helper<R, ForwardMeta>::apply(callable, meta, std::move(args));
     }
 
@@ -64,6 +64,81 @@ struct streamed {
         return write({}, std::forward<Args>(args)...);
     }
 
+    // Same as write(), but rejects the chunk with the congested_upstream error instead of queueing
+    // it if the client doesn't keep up with the data, see on_writable().
+    template<class... Args>
+    typename std::enable_if<
+        std::is_constructible<T, Args...>::value,
+        std::error_code
+    >::type
+    try_write(hpack::headers_t headers, Args&&... args) {
+        auto d = data->synchronize();
+        if (d->state == state_t::closed) {
+            return make_error_code(error::protocol_errors::closed_upstream);
+        }
+
+        if (!d->outbox.writable()) {
+            return make_error_code(error::protocol_errors::congested_upstream);
+        }
+
+        return d->outbox.template append<chunk_type>(std::move(headers), std::forward<Args>(args)...);
+    }
+
+    template<class... Args>
+    typename std::enable_if<
+        std::is_constructible<T, Args...>::value,
+        std::error_code
+    >::type
+    try_write(Args&&... args) {
+        return try_write({}, std::forward<Args>(args)...);
+    }
+
+    bool
+    writable() const {
+        return data->synchronize()->outbox.writable();
+    }
+
+    // Invokes the callback once the client has consumed enough of the pending data, which might
+    // happen right away. Called without any locks held, so it's safe to write from the callback.
+    void
+    on_writable(std::function<void()> callback) {
+        std::shared_ptr<io::basic_upstream_t> upstream;
+
+        {
+            auto d = data->synchronize();
+
+            if(d->outbox.starved()) {
+                // Woken up by the next window update, see grant().
+                d->waiters.push_back(std::move(callback));
+                return;
+            }
+
+            upstream = d->outbox.upstream();
+        }
+
+        if(upstream) {
+            upstream->on_writable(std::move(callback));
+        } else {
+            callback();
+        }
+    }
+
+    // Makes the stream obey the credit granted by the client with window updates: chunks are held
+    // back once the credit is used up, and try_write() rejects them. Clients that never send window
+    // updates are not affected.
+    void
+    enable_flow_control() {
+        auto d = data->synchronize();
+
+        if(utility::exchange(d->windowed, true)) {
+            return;
+        }
+
+        if(const auto upstream = d->outbox.upstream()) {
+            watch(upstream);
+        }
+    }
+
     std::error_code
     abort(hpack::headers_t headers, const std::error_code& ec, const std::string& reason) {
         return data->apply([&](data_t& data) {
@@ -71,7 +146,9 @@ struct streamed {
                 return make_error_code(error::protocol_errors::closed_upstream);
             }
 
-            return data.outbox.template append<error_type>(std::move(headers), ec, reason);
+            const auto rv = data.outbox.template append<error_type>(std::move(headers), ec, reason);
+            settle(data);
+            return rv;
         });
     }
 
@@ -87,7 +164,9 @@ struct streamed {
                 return make_error_code(error::protocol_errors::closed_upstream);
             }
 
-            return data.outbox.template append<choke_type>(std::move(headers));
+            const auto rv = data.outbox.template append<choke_type>(std::move(headers));
+            settle(data);
+            return rv;
         });
     }
 
@@ -99,7 +178,14 @@ struct streamed {
     template<class UpstreamType>
     void
     attach(UpstreamType&& upstream) {
-        data->synchronize()->outbox.attach(std::move(upstream));
+        auto d = data->synchronize();
+
+        d->outbox.attach(std::move(upstream));
+
+        if(d->windowed) {
+            watch(d->outbox.upstream());
+            settle(*d);
+        }
     }
 
 private:
@@ -109,12 +195,66 @@ private:
     };
 
     struct data_t {
-        data_t(): state(state_t::open) {}
+        data_t(): state(state_t::open), windowed(false) {}
 
         state_t state;
         queue_type outbox;
+
+        // Whether the stream obeys window updates, and the callbacks waiting for more credit.
+        bool windowed;
+        std::vector<std::function<void()>> waiters;
     };
 
+    void
+    watch(const std::shared_ptr<io::basic_upstream_t>& upstream) {
+        std::weak_ptr<synchronized<data_t>> weak(data);
+
+        // NOTE: The session holds the handler until the stream is closed, so it must not keep the
+        // stream alive.
+        upstream->on_window_update([weak](std::uint64_t increment) {
+            if(const auto ptr = weak.lock()) {
+                grant(*ptr, increment);
+            }
+        });
+    }
+
+    static
+    void
+    grant(synchronized<data_t>& shared, std::uint64_t increment) {
+        std::vector<std::function<void()>> waiters;
+        std::shared_ptr<io::basic_upstream_t> upstream;
+
+        shared.apply([&](data_t& data) {
+            data.outbox.grant(increment);
+            settle(data);
+
+            if(!data.outbox.starved()) {
+                waiters.swap(data.waiters);
+            }
+
+            upstream = data.outbox.upstream();
+        });
+
+        // The credit is there, but the session might still be congested.
+        for(auto it = waiters.begin(); it != waiters.end(); ++it) {
+            upstream->on_writable(std::move(*it));
+        }
+    }
+
+    // Stops listening for window updates once the stream has sent everything, including the final
+    // message.
+    static
+    void
+    settle(data_t& data) {
+        if(!data.windowed || data.state != state_t::closed || data.outbox.pending()) {
+            return;
+        }
+
+        if(const auto upstream = data.outbox.upstream()) {
+            upstream->on_window_update(nullptr);
+        }
+    }
+
     const std::shared_ptr<synchronized<data_t>> data;
 };
 
@@ -34,12 +34,24 @@ class basic_upstream_t {
     const std::shared_ptr<session_t> m_session;
     const uint64_t m_channel_id;
 
+    // Whether a window update handler has been registered for this channel.
+    std::atomic<bool> m_windowed;
+
 public:
     basic_upstream_t(const std::shared_ptr<session_t>& session, uint64_t channel_id):
         m_session(session),
-        m_channel_id(channel_id)
+        m_channel_id(channel_id),
+        m_windowed(false)
     { }
 
+    // Nobody can write into the channel anymore, so the window update handler is dropped, in case the
+    // stream hasn't done it itself.
+   ~basic_upstream_t() {
+        if(m_windowed) {
+            m_session->on_window_update(m_channel_id, nullptr);
+        }
+    }
+
     uint64_t
     channel_id() const {
         return m_channel_id;
@@ -60,6 +72,33 @@ public:
         m_session->detach(ec);
     }
 
+    /// Checks whether the session is able to accept more messages without growing its outgoing
+    /// queue above the high watermark.
+    bool
+    writable() const {
+        return m_session->writable();
+    }
+
+    /// Invokes the callback once the session becomes writable, which might happen right away.
+    void
+    on_writable(std::function<void()> callback) {
+        m_session->on_writable(std::move(callback));
+    }
+
+    /// Invokes the handler with the credit the remote peer grants for this channel. An empty handler
+    /// stops listening for the updates.
+    void
+    on_window_update(std::function<void(std::uint64_t)> handler) {
+        m_windowed = static_cast<bool>(handler);
+        m_session->on_window_update(m_channel_id, std::move(handler));
+    }
+
+    /// Allows the remote peer to send this many more chunks into this channel.
+    void
+    grant(std::uint64_t increment) {
+        m_session->grant(m_channel_id, increment);
+    }
+
     void
     send(encoder_t::message_type message) {
         m_session->push(std::move(message));
@@ -28,6 +28,10 @@
 #include <blackhole/attribute.hpp>
 #include <blackhole/logger.hpp>
 
+#include <atomic>
+#include <functional>
+#include <mutex>
+
 namespace cocaine { namespace logging {
 
 class trace_wrapper_t :
@@ -36,13 +40,26 @@ class trace_wrapper_t :
     std::unique_ptr<blackhole::logger_t> inner;
     synchronized<std::shared_ptr<filter_t>> m_filter;
 
+    // Lowest severity the current filter might accept for non-verbose traces.
+    std::atomic<blackhole::severity_t> m_threshold;
+
 public:
     trace_wrapper_t(std::unique_ptr<blackhole::logger_t> log);
 
     auto attributes() const noexcept -> blackhole::attributes_t;
 
+    /// Installs an arbitrary filter. Since it may look at the attributes, every record is considered
+    /// to be possibly enabled from now on.
     auto filter(filter_t new_filter) -> void;
 
+    /// Installs a filter which never accepts records below the given severity, unless the current
+    /// trace is verbose.
+    auto filter(filter_t new_filter, blackhole::severity_t threshold) -> void;
+
+    /// Tells whether a record with the given severity can pass the filter at all. It is cheap and
+    /// allows to skip preparing records which are going to be dropped anyway.
+    auto enabled(blackhole::severity_t severity) const -> bool;
+
     auto log(blackhole::severity_t severity, const blackhole::message_t& message) -> void;
     auto log(blackhole::severity_t severity, const blackhole::message_t& message, blackhole::attribute_pack& pack) -> void;
     auto log(blackhole::severity_t severity, const blackhole::lazy_message_t& message, blackhole::attribute_pack& pack) -> void;
@@ -50,6 +67,40 @@ public:
     auto manager() -> blackhole::scope::manager_t&;
 };
 
+/// Attaches the attributes to every record passed through the inner logger, just like the regular
+/// wrapper does, but computes them only on the first record which passes the gate. Used for
+/// short-lived objects, like sessions, which have rather expensive attributes and often have nothing
+/// to say, or say it with a severity nobody listens to.
+class lazy_wrapper_t :
+    public blackhole::logger_t
+{
+public:
+    typedef std::function<blackhole::attributes_t()> factory_type;
+    typedef std::function<bool(blackhole::severity_t)> gate_type;
+
+private:
+    const std::shared_ptr<blackhole::logger_t> inner;
+    const gate_type gate;
+
+    factory_type factory;
+    std::once_flag initialized;
+
+    blackhole::attributes_t storage;
+    blackhole::attribute_list view;
+
+public:
+    lazy_wrapper_t(std::shared_ptr<blackhole::logger_t> log, gate_type gate, factory_type factory);
+
+    auto log(blackhole::severity_t severity, const blackhole::message_t& message) -> void;
+    auto log(blackhole::severity_t severity, const blackhole::message_t& message, blackhole::attribute_pack& pack) -> void;
+    auto log(blackhole::severity_t severity, const blackhole::lazy_message_t& message, blackhole::attribute_pack& pack) -> void;
+
+    auto manager() -> blackhole::scope::manager_t&;
+
+private:
+    auto attributes() -> const blackhole::attribute_list&;
+};
+
 }} // namespace cocaine::logging
 
 #endif // COCAINE_TRACE_LOGGER
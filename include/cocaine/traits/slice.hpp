@@ -0,0 +1,75 @@
+/*
+    Copyright (c) 2011-2016 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_SLICE_SERIALIZATION_TRAITS_HPP
+#define COCAINE_SLICE_SERIALIZATION_TRAITS_HPP
+
+#include "cocaine/rpc/slice.hpp"
+#include "cocaine/traits.hpp"
+#include "cocaine/traits/literal.hpp"
+
+namespace cocaine { namespace io {
+
+// Slices are packed as plain raw strings, so they're wire compatible with std::string arguments.
+
+template<>
+struct type_traits<slice_t> {
+    template<class Stream>
+    static inline
+    void
+    pack(msgpack::packer<Stream>& target, const slice_t& source) {
+        target.pack_raw(source.size());
+        target.pack_raw_body(source.data(), source.size());
+    }
+
+    template<class Stream>
+    static inline
+    void
+    pack(msgpack::packer<Stream>& target, const std::string& source) {
+        target << source;
+    }
+
+    template<class Stream>
+    static inline
+    void
+    pack(msgpack::packer<Stream>& target, const literal_t& source) {
+        target.pack_raw(source.size);
+        target.pack_raw_body(source.blob, source.size);
+    }
+
+    static inline
+    void
+    unpack(const msgpack::object& source, slice_t& target) {
+        if(source.type != msgpack::type::RAW) {
+            throw msgpack::type_error();
+        }
+
+        const auto& raw = source.via.raw;
+
+        if(const auto owner = slice_t::scope_t::current()) {
+            target = slice_t(*owner, raw.ptr, raw.size);
+        } else {
+            target = slice_t(std::string(raw.ptr, raw.size));
+        }
+    }
+};
+
+}} // namespace cocaine::io
+
+#endif
@@ -22,17 +22,23 @@
 #define COCAINE_TYPELIST_SERIALIZATION_TRAITS_HPP
 
 #include "cocaine/common.hpp"
+#include "cocaine/errors.hpp"
 #include "cocaine/format.hpp"
 #include "cocaine/rpc/tags.hpp"
 #include "cocaine/traits.hpp"
 
+#include <limits>
+#include <string>
 #include <tuple>
+#include <vector>
 
+#include <boost/mpl/at.hpp>
 #include <boost/mpl/begin.hpp>
 #include <boost/mpl/count_if.hpp>
 #include <boost/mpl/deref.hpp>
 #include <boost/mpl/is_sequence.hpp>
 #include <boost/mpl/next.hpp>
+#include <boost/mpl/size.hpp>
 
 namespace cocaine { namespace io {
 
@@ -291,6 +297,205 @@ private:
     }
 };
 
+// Flat argument unpacking
+
+namespace aux {
+
+// Element unpackers never throw on a type mismatch, but report it instead. Common scalars, strings
+// and vectors of those are converted in place, all the other types fall back to their traits.
+
+template<class T, class = void>
+struct flat_element {
+    static inline
+    bool
+    unpack(const msgpack::object& source, T& target) {
+        try {
+            type_traits<T>::unpack(source, target);
+        } catch(const msgpack::type_error&) {
+            return false;
+        }
+
+        return true;
+    }
+};
+
+template<class T>
+struct flat_element<T, typename std::enable_if<
+    std::is_integral<T>::value && !std::is_same<T, bool>::value>::type>
+{
+    static inline
+    bool
+    unpack(const msgpack::object& source, T& target) {
+        switch(source.type) {
+        case msgpack::type::POSITIVE_INTEGER:
+            if(source.via.u64 > static_cast<std::uint64_t>(std::numeric_limits<T>::max())) {
+                return false;
+            }
+
+            target = static_cast<T>(source.via.u64);
+            return true;
+        case msgpack::type::NEGATIVE_INTEGER:
+            if(source.via.i64 < static_cast<std::int64_t>(std::numeric_limits<T>::min())) {
+                return false;
+            }
+
+            target = static_cast<T>(source.via.i64);
+            return true;
+        default:
+            return false;
+        }
+    }
+};
+
+template<>
+struct flat_element<bool> {
+    static inline
+    bool
+    unpack(const msgpack::object& source, bool& target) {
+        if(source.type != msgpack::type::BOOLEAN) {
+            return false;
+        }
+
+        target = source.via.boolean;
+        return true;
+    }
+};
+
+template<class T>
+struct flat_element<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+    static inline
+    bool
+    unpack(const msgpack::object& source, T& target) {
+        if(source.type != msgpack::type::DOUBLE) {
+            return false;
+        }
+
+        target = static_cast<T>(source.via.dec);
+        return true;
+    }
+};
+
+template<>
+struct flat_element<std::string> {
+    static inline
+    bool
+    unpack(const msgpack::object& source, std::string& target) {
+        if(source.type != msgpack::type::RAW) {
+            return false;
+        }
+
+        target.assign(source.via.raw.ptr, source.via.raw.size);
+        return true;
+    }
+};
+
+template<class T>
+struct flat_element<std::vector<T>> {
+    static inline
+    bool
+    unpack(const msgpack::object& source, std::vector<T>& target) {
+        if(source.type != msgpack::type::ARRAY) {
+            return false;
+        }
+
+        target.resize(source.via.array.size);
+
+        for(size_t i = 0; i < target.size(); ++i) {
+            if(!flat_element<T>::unpack(source.via.array.ptr[i], target[i])) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+// Argument unpackers take care of the optional arguments missing at the end of the array.
+
+template<class T>
+struct flat_argument {
+    template<class U>
+    static inline
+    bool
+    unpack(const msgpack::object_array& source, size_t index, U& target) {
+        return index < source.size && flat_element<U>::unpack(source.ptr[index], target);
+    }
+};
+
+template<class T>
+struct flat_argument<optional<T>> {
+    template<class U>
+    static inline
+    bool
+    unpack(const msgpack::object_array& source, size_t index, U& target) {
+        if(index < source.size) {
+            return flat_argument<T>::unpack(source, index, target);
+        }
+
+        target = U();
+        return true;
+    }
+};
+
+template<class T, T Default>
+struct flat_argument<optional_with_default<T, Default>> {
+    template<class U>
+    static inline
+    bool
+    unpack(const msgpack::object_array& source, size_t index, U& target) {
+        if(index < source.size) {
+            return flat_argument<T>::unpack(source, index, target);
+        }
+
+        target = Default;
+        return true;
+    }
+};
+
+} // namespace aux
+
+/// Non-throwing counterpart of type_traits<Sequence>::unpack() for argument tuples. The array type
+/// and size are checked once, then every argument is unpacked in place, without recursion. Returns
+/// error::invalid_argument on mismatch, in which case the tuple might be partially filled.
+template<class Sequence>
+struct flat_unpacker {
+    template<class... Args>
+    static
+    std::error_code
+    unpack(const msgpack::object& source, std::tuple<Args...>& target) {
+        static_assert(sizeof...(Args) == boost::mpl::size<Sequence>::value, "sequence length mismatch");
+
+        if(source.type != msgpack::type::ARRAY || source.via.array.size < type_traits<Sequence>::minimal) {
+            return error::invalid_argument;
+        }
+
+        if(!apply(source.via.array, target, typename make_index_sequence<sizeof...(Args)>::type())) {
+            return error::invalid_argument;
+        }
+
+        return std::error_code();
+    }
+
+private:
+    template<class Tuple, size_t... Indices>
+    static inline
+    bool
+    apply(const msgpack::object_array& source, Tuple& target, index_sequence<Indices...>) {
+        bool success = true;
+
+        // Expands into a flat sequence of argument unpackers, which stops at the first mismatch.
+        const bool expansion[] = {
+            true, (success = success && aux::flat_argument<
+                typename boost::mpl::at_c<Sequence, Indices>::type
+            >::unpack(source, Indices, std::get<Indices>(target)))...
+        };
+
+        (void)expansion;
+
+        return success;
+    }
+};
+
 // Tuple serialization
 
 template<class... Args>
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace cocaine {
+namespace utility {
+
+/// Open addressing hash table keyed by 64-bit identifiers, such as channel ids.
+///
+/// All the entries live in a single flat array, so lookups touch one or two cache lines and neither
+/// insertions nor removals allocate unless the table grows. Collisions are resolved with linear
+/// probing, removals shift the following entries back instead of leaving tombstones. Keys are mixed
+/// with Fibonacci hashing, so that both sequential and strided ids are spread evenly.
+///
+/// \tparam T - mapped type, must be default constructible and movable.
+template<class T>
+class flat_id_map {
+public:
+    typedef std::uint64_t key_type;
+    typedef T mapped_type;
+
+private:
+    struct slot_t {
+        slot_t():
+            used(false),
+            key(0)
+        {}
+
+        bool used;
+        key_type key;
+        mapped_type value;
+    };
+
+    static const std::size_t kMinCapacity = 16;
+
+    std::vector<slot_t> m_slots;
+    std::size_t m_size;
+
+    // Number of bits in the slot index, the capacity is always a power of two.
+    unsigned m_bits;
+
+public:
+    // Visits the entries in no particular order.
+    template<class Slot, class Value>
+    class basic_iterator {
+        friend class flat_id_map;
+
+        Slot* m_slot;
+        Slot* m_end;
+
+        basic_iterator(Slot* slot, Slot* end):
+            m_slot(slot),
+            m_end(end)
+        {
+            skip();
+        }
+
+        void
+        skip() {
+            while(m_slot != m_end && !m_slot->used) {
+                ++m_slot;
+            }
+        }
+
+    public:
+        key_type
+        key() const {
+            return m_slot->key;
+        }
+
+        Value&
+        value() const {
+            return m_slot->value;
+        }
+
+        basic_iterator&
+        operator++() {
+            ++m_slot;
+            skip();
+            return *this;
+        }
+
+        bool
+        operator==(const basic_iterator& other) const {
+            return m_slot == other.m_slot;
+        }
+
+        bool
+        operator!=(const basic_iterator& other) const {
+            return m_slot != other.m_slot;
+        }
+    };
+
+    typedef basic_iterator<slot_t, mapped_type> iterator;
+    typedef basic_iterator<const slot_t, const mapped_type> const_iterator;
+
+    flat_id_map():
+        m_slots(kMinCapacity),
+        m_size(0),
+        m_bits(4)
+    {}
+
+    std::size_t
+    size() const {
+        return m_size;
+    }
+
+    bool
+    empty() const {
+        return m_size == 0;
+    }
+
+    iterator
+    begin() {
+        return iterator(m_slots.data(), m_slots.data() + m_slots.size());
+    }
+
+    iterator
+    end() {
+        return iterator(m_slots.data() + m_slots.size(), m_slots.data() + m_slots.size());
+    }
+
+    const_iterator
+    begin() const {
+        return const_iterator(m_slots.data(), m_slots.data() + m_slots.size());
+    }
+
+    const_iterator
+    end() const {
+        return const_iterator(m_slots.data() + m_slots.size(), m_slots.data() + m_slots.size());
+    }
+
+    /// Returns a pointer to the mapped value, or nullptr if there's no such key. The pointer is
+    /// invalidated by any subsequent modification of the table.
+    mapped_type*
+    find(key_type key) {
+        const auto index = lookup(key);
+        return index < m_slots.size() ? &m_slots[index].value : nullptr;
+    }
+
+    const mapped_type*
+    find(key_type key) const {
+        const auto index = lookup(key);
+        return index < m_slots.size() ? &m_slots[index].value : nullptr;
+    }
+
+    std::size_t
+    count(key_type key) const {
+        return lookup(key) < m_slots.size() ? 1 : 0;
+    }
+
+    /// Inserts the value unless the key is already present. Returns the mapped value for the key and
+    /// whether the insertion took place.
+    template<class U>
+    std::pair<mapped_type*, bool>
+    insert(key_type key, U&& value) {
+        // Keep the load factor below 1/2, so that probe sequences stay short.
+        if((m_size + 1) * 2 > m_slots.size()) {
+            rehash(m_bits + 1);
+        }
+
+        for(std::size_t index = home(key);; index = next(index)) {
+            slot_t& slot = m_slots[index];
+
+            if(!slot.used) {
+                slot.used  = true;
+                slot.key   = key;
+                slot.value = std::forward<U>(value);
+
+                ++m_size;
+
+                return std::make_pair(&slot.value, true);
+            }
+
+            if(slot.key == key) {
+                return std::make_pair(&slot.value, false);
+            }
+        }
+    }
+
+    /// Removes the key, returns the number of removed entries.
+    std::size_t
+    erase(key_type key) {
+        auto hole = lookup(key);
+
+        if(hole == m_slots.size()) {
+            return 0;
+        }
+
+        // Move the following entries of the same probe sequence back, so that lookups never stop
+        // early at the freshly emptied slot.
+        for(std::size_t index = next(hole); m_slots[index].used; index = next(index)) {
+            const auto origin = home(m_slots[index].key);
+
+            // The entry can be moved to the hole only if the hole is cyclically between its home
+            // slot and its current position.
+            const bool movable = hole <= index ?
+                (origin <= hole || origin > index) :
+                (origin <= hole && origin > index);
+
+            if(movable) {
+                m_slots[hole].key   = m_slots[index].key;
+                m_slots[hole].value = std::move(m_slots[index].value);
+                hole = index;
+            }
+        }
+
+        m_slots[hole].used  = false;
+        m_slots[hole].value = mapped_type();
+
+        --m_size;
+
+        return 1;
+    }
+
+    void
+    clear() {
+        std::vector<slot_t>(kMinCapacity).swap(m_slots);
+
+        m_size = 0;
+        m_bits = 4;
+    }
+
+private:
+    std::size_t
+    home(key_type key) const {
+        return static_cast<std::size_t>((key * 11400714819323198485ull) >> (64 - m_bits));
+    }
+
+    std::size_t
+    next(std::size_t index) const {
+        return (index + 1) & (m_slots.size() - 1);
+    }
+
+    // Returns the index of the slot with the key, or the capacity if there's no such key.
+    std::size_t
+    lookup(key_type key) const {
+        for(std::size_t index = home(key);; index = next(index)) {
+            const slot_t& slot = m_slots[index];
+
+            if(!slot.used) {
+                return m_slots.size();
+            }
+
+            if(slot.key == key) {
+                return index;
+            }
+        }
+    }
+
+    void
+    rehash(unsigned bits) {
+        std::vector<slot_t> slots(std::size_t(1) << bits);
+
+        slots.swap(m_slots);
+        m_bits = bits;
+
+        for(auto it = slots.begin(); it != slots.end(); ++it) {
+            if(!it->used) {
+                continue;
+            }
+
+            std::size_t index = home(it->key);
+
+            while(m_slots[index].used) {
+                index = next(index);
+            }
+
+            m_slots[index].used  = true;
+            m_slots[index].key   = it->key;
+            m_slots[index].value = std::move(it->value);
+        }
+    }
+};
+
+}  // namespace utility
+}  // namespace cocaine
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+namespace cocaine {
+namespace utility {
+
+/// Lock-free histogram of non-negative integer values, such as latencies in microseconds.
+///
+/// Buckets are log-linear: every power of two range is split into eight equal buckets, so quantiles
+/// are reported with at most 12.5% relative error. Recording a value is a single relaxed atomic
+/// increment, reading quantiles walks all the buckets.
+class histogram {
+public:
+    // Every power of two range is split into 2^kPrecision buckets.
+    static const unsigned kPrecision = 3;
+
+    // Values are clamped to 2^kRange - 1, which is about twelve days in microseconds.
+    static const unsigned kRange = 40;
+
+    static const std::size_t kBuckets = (kRange - kPrecision + 1) << kPrecision;
+
+    histogram() {
+        reset();
+    }
+
+    histogram(const histogram& other) = delete;
+    histogram& operator=(const histogram& other) = delete;
+
+    void
+    record(std::uint64_t value) {
+        buckets[index(value)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::uint64_t
+    count() const {
+        std::uint64_t result = 0;
+
+        for(auto it = buckets.begin(); it != buckets.end(); ++it) {
+            result += it->load(std::memory_order_relaxed);
+        }
+
+        return result;
+    }
+
+    /// Returns the upper bound of the bucket the specified quantile falls into, or zero if nothing
+    /// has been recorded yet.
+    std::uint64_t
+    quantile(double q) const {
+        snapshot_type snapshot = {};
+
+        collect(snapshot);
+
+        return quantile(snapshot, q);
+    }
+
+    typedef std::array<std::uint64_t, kBuckets> snapshot_type;
+
+    /// Adds the bucket counts to the snapshot, so that multiple histograms can be merged.
+    void
+    collect(snapshot_type& snapshot) const {
+        for(std::size_t i = 0; i < kBuckets; ++i) {
+            snapshot[i] += buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    static
+    std::uint64_t
+    quantile(const snapshot_type& snapshot, double q) {
+        std::uint64_t total = 0;
+
+        for(std::size_t i = 0; i < kBuckets; ++i) {
+            total += snapshot[i];
+        }
+
+        if(total == 0) {
+            return 0;
+        }
+
+        const auto rank = std::max<std::uint64_t>(1, std::ceil(q * total));
+
+        std::uint64_t accumulated = 0;
+
+        for(std::size_t i = 0; i < kBuckets; ++i) {
+            if((accumulated += snapshot[i]) >= rank) {
+                return upper(i);
+            }
+        }
+
+        return upper(kBuckets - 1);
+    }
+
+    void
+    reset() {
+        for(auto it = buckets.begin(); it != buckets.end(); ++it) {
+            it->store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    static
+    std::size_t
+    index(std::uint64_t value) {
+        if(value < (1u << kPrecision)) {
+            return value;
+        }
+
+        if(value >> kRange) {
+            value = (std::uint64_t(1) << kRange) - 1;
+        }
+
+        // Position of the highest bit, and the bits right after it select the bucket in its range.
+        const unsigned exponent = 63 - __builtin_clzll(value);
+        const auto mantissa = (value >> (exponent - kPrecision)) & ((1u << kPrecision) - 1);
+
+        return ((exponent - kPrecision + 1) << kPrecision) + mantissa;
+    }
+
+    static
+    std::uint64_t
+    upper(std::size_t index) {
+        if(index < (1u << kPrecision)) {
+            return index;
+        }
+
+        const unsigned exponent = (index >> kPrecision) + kPrecision - 1;
+        const auto mantissa = index & ((1u << kPrecision) - 1);
+
+        const auto lower = ((std::uint64_t(1) << kPrecision) + mantissa) << (exponent - kPrecision);
+
+        return lower + (std::uint64_t(1) << (exponent - kPrecision)) - 1;
+    }
+
+    std::array<std::atomic<std::uint64_t>, kBuckets> buckets;
+};
+
+/// Histogram of the values recorded recently, i.e. within the last one or two intervals.
+///
+/// Values are recorded into the window of the current interval, while quantiles are computed over it
+/// and the previous one. Windows are recycled lazily once their interval is over, so old values stop
+/// affecting quantiles, much like with exponentially decaying reservoirs. The total count covers the
+/// whole lifetime.
+class windowed_histogram {
+public:
+    typedef std::chrono::steady_clock clock_type;
+
+    explicit
+    windowed_histogram(clock_type::duration interval_ = std::chrono::seconds(30)):
+        interval(interval_),
+        epoch(current()),
+        total(0)
+    { }
+
+    windowed_histogram(const windowed_histogram& other) = delete;
+    windowed_histogram& operator=(const windowed_histogram& other) = delete;
+
+    void
+    record(std::uint64_t value) {
+        windows[advance() & 1].record(value);
+        total.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::uint64_t
+    count() const {
+        return total.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t
+    quantile(double q) const {
+        advance();
+
+        histogram::snapshot_type snapshot = {};
+
+        windows[0].collect(snapshot);
+        windows[1].collect(snapshot);
+
+        return histogram::quantile(snapshot, q);
+    }
+
+private:
+    std::int64_t
+    current() const {
+        return clock_type::now().time_since_epoch() / interval;
+    }
+
+    // Switches to the window of the current interval, if it's not there yet, and returns its number.
+    // NOTE: Values recorded concurrently with the switch might end up in the next window, or be lost
+    // along with the recycled one, which is fine for metrics.
+    std::int64_t
+    advance() const {
+        const auto now = current();
+        auto last = epoch.load(std::memory_order_relaxed);
+
+        while(now > last) {
+            if(epoch.compare_exchange_weak(last, now, std::memory_order_relaxed)) {
+                // The window of the current interval still holds the values of the one before the
+                // previous, and if no values were recorded for a while, both are stale.
+                windows[now & 1].reset();
+
+                if(now - last > 1) {
+                    windows[(now + 1) & 1].reset();
+                }
+
+                break;
+            }
+        }
+
+        return std::max(now, last);
+    }
+
+    const clock_type::duration interval;
+
+    mutable std::array<histogram, 2> windows;
+    mutable std::atomic<std::int64_t> epoch;
+
+    std::atomic<std::uint64_t> total;
+};
+
+}  // namespace utility
+}  // namespace cocaine
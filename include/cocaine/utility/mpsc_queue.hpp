@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+
+#include <boost/optional/optional.hpp>
+
+namespace cocaine {
+namespace utility {
+
+/// Unbounded lock-free queue with multiple producers and a single consumer.
+///
+/// Producers never block each other: pushing is a single atomic exchange plus a store. The consumer
+/// might transiently observe the queue as empty while some producer is in the middle of a push, so
+/// consumers should be notified by producers after the push is complete rather than poll.
+///
+/// \tparam T - value type, must be move constructible.
+template<class T>
+class mpsc_queue {
+    struct node_t {
+        node_t():
+            next(nullptr)
+        {}
+
+        template<class U>
+        explicit
+        node_t(U&& value_):
+            next(nullptr),
+            value(std::forward<U>(value_))
+        {}
+
+        std::atomic<node_t*> next;
+        boost::optional<T> value;
+    };
+
+    // Producers side, the most recently pushed node.
+    std::atomic<node_t*> head;
+
+    // Consumer side, the node preceding the first element. Its value has been already consumed.
+    node_t* tail;
+
+public:
+    mpsc_queue():
+        head(new node_t),
+        tail(head.load())
+    {}
+
+    mpsc_queue(const mpsc_queue& other) = delete;
+    mpsc_queue& operator=(const mpsc_queue& other) = delete;
+
+   ~mpsc_queue() {
+        while(node_t* node = tail) {
+            tail = node->next.load(std::memory_order_relaxed);
+            delete node;
+        }
+    }
+
+    /// Appends the value to the queue. Can be called from any thread.
+    template<class U>
+    void
+    push(U&& value) {
+        node_t* node = new node_t(std::forward<U>(value));
+        node_t* prev = head.exchange(node, std::memory_order_acq_rel);
+
+        // NOTE: Between these two operations the chain is broken, so the consumer sees all the nodes
+        // pushed after this one as not yet available.
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    /// Extracts the oldest value, if any. Must be called from the consumer thread only.
+    boost::optional<T>
+    pop() {
+        node_t* next = tail->next.load(std::memory_order_acquire);
+
+        if(next == nullptr) {
+            return boost::none;
+        }
+
+        delete tail;
+        tail = next;
+
+        boost::optional<T> result(std::move(next->value));
+        next->value = boost::none;
+
+        return result;
+    }
+
+    /// Checks whether there is something to pop. Must be called from the consumer thread only.
+    bool
+    empty() const {
+        return tail->next.load(std::memory_order_acquire) == nullptr;
+    }
+};
+
+}  // namespace utility
+}  // namespace cocaine
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace cocaine {
+namespace utility {
+
+/// Value which is read all the time and updated rarely, like slot tables of service dispatches.
+///
+/// Readers never lock, they access the current immutable snapshot while registered in one of two
+/// reader counters. Updates modify a staged copy of the snapshot, which is published by the next read
+/// with an atomic pointer swap. The readers are then switched to the other counter, and the previous
+/// counter has to drain before the old snapshot is destroyed.
+///
+/// Consecutive updates are applied to the same staged copy, so building the value with a series of
+/// updates, e.g. registering the slots of a dispatch one by one, costs a single copy and no waiting.
+///
+/// NOTE: Publishing waits for the readers, so updating the value from within read() deadlocks.
+template<class T>
+class read_mostly {
+    mutable std::atomic<const T*> m_value;
+
+    // Readers register in the counter selected by the parity of the epoch.
+    mutable std::atomic<std::size_t> m_epoch;
+    mutable std::atomic<std::size_t> m_readers[2];
+
+    // Updated copy of the value yet to be published. Guarded by the mutex, which also serializes the
+    // updates and publishing.
+    mutable std::unique_ptr<T> m_staged;
+    mutable std::atomic<bool> m_dirty;
+    mutable std::mutex m_mutex;
+
+    class scope_t {
+        const read_mostly& parent;
+        std::size_t epoch;
+
+    public:
+        explicit
+        scope_t(const read_mostly& parent_):
+            parent(parent_)
+        {
+            for(epoch = parent.m_epoch.load(); ; epoch = parent.m_epoch.load()) {
+                parent.m_readers[epoch & 1].fetch_add(1);
+
+                // If the epoch has changed in the meantime, the publishing might have already checked
+                // this counter, so the registration doesn't count.
+                if(parent.m_epoch.load() == epoch) {
+                    break;
+                }
+
+                parent.m_readers[epoch & 1].fetch_sub(1);
+            }
+        }
+
+       ~scope_t() {
+            parent.m_readers[epoch & 1].fetch_sub(1);
+        }
+    };
+
+public:
+    template<class... Args>
+    explicit
+    read_mostly(Args&&... args):
+        m_value(new T(std::forward<Args>(args)...)),
+        m_epoch(0),
+        m_dirty(false)
+    {
+        m_readers[0] = 0;
+        m_readers[1] = 0;
+    }
+
+    read_mostly(const read_mostly& other) = delete;
+    read_mostly& operator=(const read_mostly& other) = delete;
+
+   ~read_mostly() {
+        delete m_value.load();
+    }
+
+    /// Invokes the callable with the current value, publishing the pending updates first. The
+    /// reference must not escape the callable.
+    template<class F>
+    auto
+    read(F&& fn) const -> decltype(fn(std::declval<const T&>())) {
+        if(m_dirty.load(std::memory_order_acquire)) {
+            publish();
+        }
+
+        const scope_t scope(*this);
+        return fn(*m_value.load());
+    }
+
+    /// Invokes the callable with the staged copy of the value, which is visible to readers from then
+    /// on. If the callable throws, it must leave the value intact.
+    template<class F>
+    void
+    update(F&& fn) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        if(!m_staged) {
+            m_staged.reset(new T(*m_value.load()));
+        }
+
+        fn(*m_staged);
+
+        m_dirty.store(true, std::memory_order_release);
+    }
+
+private:
+    void
+    publish() const {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        if(!m_staged) {
+            // Published by some other reader in the meantime.
+            return;
+        }
+
+        const std::unique_ptr<const T> previous(m_value.exchange(m_staged.release()));
+
+        m_dirty.store(false, std::memory_order_release);
+
+        // Readers which might still see the previous value are all registered in the old counter.
+        const auto epoch = m_epoch.fetch_add(1);
+
+        while(m_readers[epoch & 1].load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+};
+
+}  // namespace utility
+}  // namespace cocaine
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace cocaine {
+namespace utility {
+
+/// Counter which is cheap to update from many threads at once, at the cost of slower reads.
+///
+/// Every thread picks one of the shards on its first update and sticks to it. Shards are padded to
+/// the cache line size, so that engine threads never bounce the same cache line back and forth. The
+/// value is aggregated when read, which makes reads a bit racy, but that is fine for metrics.
+class sharded_counter {
+public:
+    static const std::size_t kShards = 16;
+
+    sharded_counter() {
+        for(auto it = shards.begin(); it != shards.end(); ++it) {
+            it->value.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    sharded_counter(const sharded_counter& other) = delete;
+    sharded_counter& operator=(const sharded_counter& other) = delete;
+
+    void
+    add(std::int64_t delta) {
+        shards[shard()].value.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    std::int64_t
+    load() const {
+        std::int64_t result = 0;
+
+        for(auto it = shards.begin(); it != shards.end(); ++it) {
+            result += it->value.load(std::memory_order_relaxed);
+        }
+
+        return result;
+    }
+
+private:
+    // NOTE: Atomics which are a cache line apart never share it, regardless of the alignment of the
+    // whole object, so plain padding is enough.
+    struct shard_t {
+        std::atomic<std::int64_t> value;
+        char padding[64 - sizeof(std::atomic<std::int64_t>)];
+    };
+
+    static
+    std::size_t
+    shard() {
+        static std::atomic<std::size_t> threads(0);
+        static thread_local const std::size_t index = threads.fetch_add(1, std::memory_order_relaxed) % kShards;
+
+        return index;
+    }
+
+    std::array<shard_t, kShards> shards;
+};
+
+}  // namespace utility
+}  // namespace cocaine
@@ -34,11 +34,15 @@
 #include "cocaine/rpc/basic_dispatch.hpp"
 
 #include <asio/local/stream_protocol.hpp>
+#include <asio/posix/stream_descriptor.hpp>
 
 #include <blackhole/logger.hpp>
 
 #include <metrics/registry.hpp>
 
+#include <sys/socket.h>
+#include <unistd.h>
+
 #include "chamber.hpp"
 
 using namespace cocaine;
@@ -77,29 +81,57 @@ private:
     context_t& context;
     // Reference to an event loop tasks are running on.
     asio::io_service& loop;
-    socket_type socket;
     std::unique_ptr<acceptor_type> acceptor;
+    // Duplicate of the acceptor's descriptor to wait for incoming connections on, because acceptors
+    // can't wait without accepting something. Closed on cancellation.
+    asio::posix::stream_descriptor readiness;
     endpoint_type m_local_endpoint;
+    // Execution unit owning the reactor, if any. Otherwise, connections are handed off to the least
+    // busy one.
+    execution_unit_t* engine;
     io::dispatch_ptr_t prototype;
     metrics_t metrics;
     std::unique_ptr<logging::logger_t> log;
 
+    // Maximum number of connections accepted in one go, before yielding to other handlers.
+    static const size_t kBudget = 64;
+
 public:
-    accept_action_t(parent_type& parent, std::unique_ptr<acceptor_type> acceptor):
+    accept_action_t(parent_type& parent, std::unique_ptr<acceptor_type> acceptor, execution_unit_t* engine):
         context(parent.m_context),
         loop(acceptor->get_io_service()),
-        socket(loop),
         acceptor(std::move(acceptor)),
+        readiness(loop),
         m_local_endpoint(this->acceptor->local_endpoint()),
+        engine(engine),
         prototype(parent.m_prototype),
         metrics(context, prototype->name()),
         log(context.log("core/asio", {{"service", parent.m_prototype->name()}}))
-    {}
+    {
+        // Connections are accepted manually until the backlog is empty.
+        this->acceptor->non_blocking(true);
+
+        int fd;
+
+        if((fd = ::dup(this->acceptor->native_handle())) == -1) {
+            throw std::system_error(errno, std::system_category(), "unable to clone acceptor's socket");
+        }
+
+        std::error_code ec;
+
+        if(readiness.assign(fd, ec)) {
+            ::close(fd);
+            throw std::system_error(ec, "unable to clone acceptor's socket");
+        }
+    }
 
     void
     cancel() {
-        loop.post([&] {
-            acceptor->cancel();
+        auto self = this->shared_from_this();
+
+        loop.post([self] {
+            std::error_code ec;
+            self->readiness.close(ec);
         });
     }
 
@@ -110,45 +142,68 @@ public:
 
     void
     run() {
-        acceptor->async_accept(
-            socket,
-            std::bind(&accept_action_t::finalize, this->shared_from_this(), ph::_1)
-        );
-    }
+        if(!readiness.is_open()) {
+            return;
+        }
 
-private:
-    void
-    finalize(const std::error_code& ec) {
-        // Prepare the internal socket object for consequential operations by moving its contents
-        // to a heap-allocated object, which in turn might be attached to an engine.
-        auto ptr = std::make_unique<socket_type>(std::move(socket));
+        // Drain the backlog, handing the connections off to the engines right away, without wrapping
+        // them into sockets of this loop.
+        for(size_t accepted = 0; accepted < kBudget; ++accepted) {
+            const int fd = ::accept4(acceptor->native_handle(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+            if(fd == -1) {
+                const std::error_code ec(errno, std::system_category());
+
+                switch(ec.value()) {
+                case EINTR:
+                    continue;
+                case EAGAIN:
+                    return wait();
+                default:
+                    COCAINE_LOG_ERROR(log, "unable to accept connection: [{}] {}", ec.value(),
+                        ec.message());
+                    metrics.connections_rejected->fetch_add(1);
+                }
+
+                // Connections aborted by clients don't affect the rest of the backlog, unlike running
+                // out of descriptors or memory.
+                if(ec.value() == ECONNABORTED || ec.value() == EPROTO) {
+                    continue;
+                }
+
+                return wait();
+            }
 
-        switch(ec.value()) {
-        case 0:
-            COCAINE_LOG_DEBUG(log, "accepted connection on fd {}", acceptor->native_handle());
+            COCAINE_LOG_DEBUG(log, "accepted connection on fd {}", fd);
             metrics.connections_accepted->fetch_add(1);
 
             try {
-                context.engine().attach(std::move(ptr), prototype);
+                (engine ? *engine : context.engine()).attach(m_local_endpoint.protocol(), fd, prototype);
             } catch(const std::system_error& e) {
                 COCAINE_LOG_ERROR(log, "unable to attach connection to engine: {}",
                     error::to_string(e));
-                ptr = nullptr;
             }
-            break;
-        case asio::error::operation_aborted:
+        }
+
+        // The budget is exhausted, so let other handlers run before continuing.
+        loop.post(std::bind(&accept_action_t::run, this->shared_from_this()));
+    }
+
+private:
+    void
+    wait() {
+        readiness.async_read_some(
+            asio::null_buffers(),
+            std::bind(&accept_action_t::finalize, this->shared_from_this(), ph::_1)
+        );
+    }
+
+    void
+    finalize(const std::error_code& ec) {
+        if(ec == asio::error::operation_aborted) {
             return;
-        default:
-            COCAINE_LOG_ERROR(log, "unable to accept connection: [{}] {}", ec.value(),
-                ec.message());
-            metrics.connections_rejected->fetch_add(1);
-            break;
         }
 
-        // TODO: Find out if it's always a good idea to continue accepting connections no matter
-        // what.
-        // For example, destroying a socket from outside this thread will trigger weird stuff on
-        // Linux.
         run();
     }
 };
@@ -173,7 +228,7 @@ actor_base<Protocol>::~actor_base() = default;
 template<typename Protocol>
 bool
 actor_base<Protocol>::is_active() const {
-    return static_cast<bool>(*m_acceptor.synchronize());
+    return !m_acceptors.synchronize()->empty();
 }
 
 template<typename Protocol>
@@ -185,12 +240,23 @@ actor_base<Protocol>::prototype() const {
 template<typename Protocol>
 void
 actor_base<Protocol>::run() {
-    m_acceptor.apply([this](std::shared_ptr<accept_action_t>& action) {
+    m_acceptors.apply([this](std::vector<std::shared_ptr<accept_action_t>>& actions) {
         auto endpoint = make_endpoint();
 
-        std::unique_ptr<acceptor_type> acceptor;
+        std::vector<std::pair<std::unique_ptr<acceptor_type>, execution_unit_t*>> acceptors;
         try {
-            acceptor = m_context.expose<Protocol>(endpoint);
+            if(m_context.config().network().reuseport() && std::is_same<Protocol, tcp>::value) {
+                m_context.each_engine([&](execution_unit_t& engine) {
+                    // The rest of the acceptors join the first one, which might have been assigned an
+                    // ephemeral port.
+                    acceptors.emplace_back(
+                        engine.expose<Protocol>(acceptors.empty() ? endpoint : acceptors.front().first->local_endpoint()),
+                        &engine
+                    );
+                });
+            } else {
+                acceptors.emplace_back(m_context.expose<Protocol>(endpoint), nullptr);
+            }
         } catch(const std::system_error& e) {
             COCAINE_LOG_ERROR(m_log, "unable to bind local endpoint {} for service: {}", endpoint, error::to_string(e));
             m_context.mapper().retain(m_prototype->name());
@@ -198,13 +264,18 @@ actor_base<Protocol>::run() {
         }
 
         std::error_code ec;
-        COCAINE_LOG_INFO(m_log, "exposing service on local endpoint {}", acceptor->local_endpoint(ec));
+        COCAINE_LOG_INFO(m_log, "exposing service on local endpoint {} with {:d} acceptor(s)",
+            acceptors.front().first->local_endpoint(ec), acceptors.size());
 
-        auto& loop = acceptor->get_io_service();
-        action = std::make_shared<accept_action_t>(*this, std::move(acceptor));
-        loop.post([=] {
-            action->run();
-        });
+        for(auto it = acceptors.begin(); it != acceptors.end(); ++it) {
+            auto& loop = it->first->get_io_service();
+            auto action = std::make_shared<accept_action_t>(*this, std::move(it->first), it->second);
+            loop.post([=] {
+                action->run();
+            });
+
+            actions.push_back(std::move(action));
+        }
     });
 
     on_run();
@@ -213,13 +284,20 @@ actor_base<Protocol>::run() {
 template<typename Protocol>
 void
 actor_base<Protocol>::terminate() {
-    m_acceptor.apply([this](std::shared_ptr<accept_action_t>& action) {
-        const auto endpoint = action->local_endpoint();
+    m_acceptors.apply([this](std::vector<std::shared_ptr<accept_action_t>>& actions) {
+        if(actions.empty()) {
+            return;
+        }
+
+        const auto endpoint = actions.front()->local_endpoint();
 
         COCAINE_LOG_INFO(m_log, "removing service from local endpoint {}", endpoint);
 
-        action->cancel();
-        action = nullptr;
+        for(auto it = actions.begin(); it != actions.end(); ++it) {
+            (*it)->cancel();
+        }
+
+        actions.clear();
     });
 
     on_terminate();
@@ -228,9 +306,9 @@ actor_base<Protocol>::terminate() {
 template<typename Protocol>
 auto
 actor_base<Protocol>::local_endpoint() const -> endpoint_type {
-    return m_acceptor.apply([&](const std::shared_ptr<accept_action_t>& action) {
-        if (action) {
-            return action->local_endpoint();
+    return m_acceptors.apply([&](const std::vector<std::shared_ptr<accept_action_t>>& actions) {
+        if (!actions.empty()) {
+            return actions.front()->local_endpoint();
         } else {
             throw std::system_error(std::make_error_code(std::errc::not_connected));
         }
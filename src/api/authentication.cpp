@@ -16,7 +16,7 @@ authentication_t::identify(const hpack::headers_t& headers) const -> auth::ident
     // Even if there is no credentials provided some authorization components may allow access.
     std::string credentials;
     if (auto header = hpack::header::find_first<hpack::headers::authorization<>>(headers)) {
-        credentials = header->value();
+        credentials.assign(header->value_data(), header->value_size());
     }
 
     return identify(credentials);
@@ -40,11 +40,14 @@ using namespace cocaine::io;
 class chamber_t::named_runnable_t {
     const std::string name;
     const std::shared_ptr<asio::io_service>& asio;
+    const cpuset_t cpus;
 
 public:
-    named_runnable_t(const std::string& name_, const std::shared_ptr<asio::io_service>& asio_):
+    named_runnable_t(const std::string& name_, const std::shared_ptr<asio::io_service>& asio_,
+                     const cpuset_t& cpus_):
         name(name_),
-        asio(asio_)
+        asio(asio_),
+        cpus(cpus_)
     { }
 
     void
@@ -63,6 +66,9 @@ chamber_t::named_runnable_t::operator()() const {
     pthread_setname_np(name.c_str());
 #endif
 
+    // NOTE: Configured CPU sets are checked against the ones available to the process in advance.
+    cpus.apply();
+
     asio->run();
 }
 
@@ -140,7 +146,8 @@ chamber_t::stats_periodic_action_t::finalize(const std::error_code& ec) {
 
 namespace bpt = boost::posix_time;
 
-chamber_t::chamber_t(const std::string& name_, const std::shared_ptr<asio::io_service>& asio_):
+chamber_t::chamber_t(const std::string& name_, const std::shared_ptr<asio::io_service>& asio_,
+                     const cpuset_t& cpus):
     name(name_),
     asio(asio_),
     cron(*asio_),
@@ -153,7 +160,7 @@ chamber_t::chamber_t(const std::string& name_, const std::shared_ptr<asio::io_se
     // Bootstrap the rolling mean to avoid showing NaNs to the first clients.
     (*load_acc1.synchronize())(0.0f);
 
-    thread = std::make_unique<boost::thread>(named_runnable_t(name, asio));
+    thread = std::make_unique<boost::thread>(named_runnable_t(name, asio, cpus));
 }
 
 chamber_t::~chamber_t() {
@@ -22,6 +22,7 @@
 #define COCAINE_CHAMBER_HPP
 
 #include "cocaine/common.hpp"
+#include "cocaine/cpuset.hpp"
 #include "cocaine/locked_ptr.hpp"
 
 #include <boost/accumulators/accumulators.hpp>
@@ -58,7 +59,9 @@ class chamber_t {
     synchronized<load_average_t> load_acc1;
 
 public:
-    chamber_t(const std::string& name, const std::shared_ptr<asio::io_service>& asio);
+    // The thread is pinned to the specified CPUs, if any.
+    chamber_t(const std::string& name, const std::shared_ptr<asio::io_service>& asio,
+              const cpuset_t& cpus = cpuset_t());
    ~chamber_t();
 
     auto
@@ -28,8 +28,10 @@
 #include "cocaine/context/mapper.hpp"
 #include "cocaine/context/quote.hpp"
 #include "cocaine/context/signal.hpp"
+#include "cocaine/cpuset.hpp"
 #include "cocaine/detail/essentials.hpp"
 #include "cocaine/engine.hpp"
+#include "cocaine/executor/stealing.hpp"
 #include "cocaine/format.hpp"
 #include "cocaine/format/exception.hpp"
 #include "cocaine/idl/context.hpp"
@@ -48,8 +50,10 @@
 
 #include <metrics/registry.hpp>
 
+#include <atomic>
 #include <deque>
 #include <exception>
+#include <mutex>
 
 #include "chamber.hpp"
 
@@ -79,7 +83,7 @@ using blackhole::scope::holder_t;
 
 class context_impl_t : public context_t {
     using service_list_t = std::deque<std::pair<std::string, std::unique_ptr<tcp_actor_t>>>;
-    using engine_pool_t = std::vector<std::unique_ptr<execution_unit_t>>;
+    using engine_pool_t = std::vector<std::shared_ptr<execution_unit_t>>;
     // TODO: There was an idea to use the Repository to enable pluggable sinks and whatever else for
     // for the Blackhole, when all the common stuff is extracted to a separate library.
     std::unique_ptr<logging::trace_wrapper_t> m_log;
@@ -94,6 +98,21 @@ class context_impl_t : public context_t {
     // A pool of execution units - threads responsible for doing all the service invocations.
     engine_pool_t m_pool;
 
+    // Execution units pinned to the NUMA node of the network interface, if configured. These are
+    // preferred for new connections as long as they are not too busy.
+    engine_pool_t m_nearby;
+
+    // Utilization of a nearby execution unit, starting from which connections go to the whole pool.
+    static constexpr double kSpillover = 0.8;
+
+    // Shared pool of threads for CPU-bound work, started on first use, so that nodes which don't
+    // need it don't keep idle threads around. It's stopped on termination, but lives as long as the
+    // context, so that the work spawned afterwards is rejected instead of hitting a null pointer.
+    std::unique_ptr<cocaine::executor::stealing_t> m_executor;
+    std::atomic<cocaine::executor::stealing_t*> m_executor_ptr;
+    std::mutex m_executor_mutex;
+    bool m_executor_stopped;
+
     // Services are stored as a vector of pairs to preserve the initialization order. Synchronized,
     // because services are allowed to start and stop other services during their lifetime.
     synchronized<service_list_t> m_services;
@@ -118,6 +137,8 @@ public:
                    std::unique_ptr<api::repository_t> _repository) :
         m_log(new logging::trace_wrapper_t(std::move(_log))),
         m_repository(std::move(_repository)),
+        m_executor_ptr(nullptr),
+        m_executor_stopped(false),
         m_bootstrapped(false),
         m_config(std::move(_config)),
         m_mapper(*m_config)
@@ -135,13 +156,28 @@ public:
         // Load the rest of plugins.
         m_repository->load(m_config->path().plugins());
 
-        m_acceptor_thread = std::make_unique<io::chamber_t>("acceptor", std::make_shared<io::io_service>());
+        const auto& threads = m_config->threads();
+
+        m_acceptor_thread = std::make_unique<io::chamber_t>("acceptor", std::make_shared<io::io_service>(),
+            threads.acceptor());
 
         // Spin up all the configured services, launch execution units.
         COCAINE_LOG_INFO(m_log, "starting {:d} execution unit(s)", m_config->network().pool());
 
         while (m_pool.size() != m_config->network().pool()) {
-            m_pool.emplace_back(std::make_unique<execution_unit_t>(*this));
+            const auto& cpus = threads.engines().empty() ?
+                cpuset_t() :
+                threads.engines()[m_pool.size() % threads.engines().size()];
+
+            m_pool.emplace_back(std::make_shared<execution_unit_t>(*this, cpus));
+
+            if(!threads.interface().empty() && !cpus.empty() && threads.interface().contains(cpus)) {
+                m_nearby.push_back(m_pool.back());
+            }
+        }
+
+        if(!m_nearby.empty()) {
+            COCAINE_LOG_INFO(m_log, "{:d} execution unit(s) are local to the network interface", m_nearby.size());
         }
 
         COCAINE_LOG_INFO(m_log, "starting {:d} service(s)", m_config->services().size());
@@ -222,6 +258,11 @@ public:
         m_log->filter(std::move(new_filter));
     }
 
+    bool
+    logger_enabled(blackhole::severity_t severity) const override {
+        return m_log->enabled(severity);
+    }
+
     api::repository_t&
     repository() const override {
         return *m_repository;
@@ -364,9 +405,51 @@ public:
 
     execution_unit_t&
     engine() override {
+        if(!m_nearby.empty()) {
+            auto& unit = *m_engine_distributor->next(m_nearby);
+
+            if(unit.utilization() < kSpillover) {
+                return unit;
+            }
+        }
+
         return *m_engine_distributor->next(m_pool);
     }
 
+    auto
+    executor() -> api::executor_t& override {
+        if(const auto ptr = m_executor_ptr.load(std::memory_order_acquire)) {
+            return *ptr;
+        }
+
+        std::lock_guard<std::mutex> lock(m_executor_mutex);
+
+        if(!m_executor) {
+            if(m_executor_stopped) {
+                throw std::system_error(std::make_error_code(std::errc::operation_canceled),
+                    "executor is stopped");
+            }
+
+            const auto& threads = m_config->threads();
+
+            COCAINE_LOG_INFO(m_log, "starting {:d} executor thread(s)", threads.workers());
+
+            m_executor = std::make_unique<cocaine::executor::stealing_t>(threads.workers(), threads.executors());
+            m_executor->publish(m_metrics_registry, "executor");
+
+            m_executor_ptr.store(m_executor.get(), std::memory_order_release);
+        }
+
+        return *m_executor;
+    }
+
+    auto
+    each_engine(const std::function<void(execution_unit_t&)>& fn) -> void override {
+        for(auto it = m_pool.begin(); it != m_pool.end(); ++it) {
+            fn(**it);
+        }
+    }
+
     void
     terminate() {
         COCAINE_LOG_INFO(m_log, "stopping {:d} service(s)", m_services->size());
@@ -405,7 +488,21 @@ public:
 
         // BOOST_ASSERT(m_services->empty());
 
+        // Let the outstanding work complete, as it might still respond to the clients. Spawning more
+        // work from the outside fails from now on.
+        const auto executor = [&]() -> cocaine::executor::stealing_t* {
+            std::lock_guard<std::mutex> lock(m_executor_mutex);
+            m_executor_stopped = true;
+            return m_executor.get();
+        }();
+
+        // NOTE: Stopped without the lock held, as the work might need the executor to spawn more.
+        if(executor) {
+            executor->stop();
+        }
+
         COCAINE_LOG_INFO(m_log, "stopping {:d} execution unit(s)", m_pool.size());
+        m_nearby.clear();
         m_pool.clear();
 
         // Destroy the service objects.
@@ -428,7 +525,7 @@ private:
         auto filter = [=](filter_t::severity_t severity, filter_t::attribute_pack&) -> bool {
             return severity >= config_severity || trace_t::current().verbose();
         };
-        logger_filter(filter_t(std::move(filter)));
+        m_log->filter(filter_t(std::move(filter)), config_severity);
     }
 };
 
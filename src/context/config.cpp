@@ -19,6 +19,7 @@
 */
 
 #include "cocaine/context/config.hpp"
+#include "cocaine/cpuset.hpp"
 #include "cocaine/defaults.hpp"
 #include "cocaine/dynamic.hpp"
 #include "cocaine/errors.hpp"
@@ -191,6 +192,36 @@ public:
             return m_pool;
         }
 
+        virtual
+        bool
+        compression() const {
+            return m_compression;
+        }
+
+        virtual
+        size_t
+        budget() const {
+            return m_budget;
+        }
+
+        virtual
+        size_t
+        batch() const {
+            return m_batch;
+        }
+
+        virtual
+        const std::string&
+        transport() const {
+            return m_transport;
+        }
+
+        virtual
+        bool
+        reuseport() const {
+            return m_reuseport;
+        }
+
         network_t(const dynamic_t::object_t& source) :
             m_ports(source)
         {
@@ -216,12 +247,133 @@ public:
             if(m_pool <= 0) {
                 throw cocaine::error_t("network I/O pool size must be positive");
             }
+
+            m_compression = source.at("compression", false).as_bool();
+            m_budget      = source.at("budget", defaults::pull_budget).as_uint();
+
+            if(m_budget <= 0) {
+                throw cocaine::error_t("network message budget must be positive");
+            }
+
+            m_batch = source.at("batch", defaults::flush_batch).as_uint();
+
+            if(m_batch <= 0) {
+                throw cocaine::error_t("network write batch must be positive");
+            }
+
+            m_transport = source.at("transport", "asio").as_string();
+
+            if(m_transport != "asio" && m_transport != "uring") {
+                throw cocaine::error_t("unknown network transport \"{}\"", m_transport);
+            }
+
+            m_reuseport = source.at("reuseport", false).as_bool();
         }
 
         ports_t m_ports;
         std::string m_endpoint;
         std::string m_hostname;
         size_t m_pool;
+        bool m_compression;
+        size_t m_budget;
+        size_t m_batch;
+        std::string m_transport;
+        bool m_reuseport;
+    };
+
+    struct threads_t : public config_t::threads_t {
+        virtual
+        const std::vector<cpuset_t>&
+        engines() const {
+            return m_engines;
+        }
+
+        virtual
+        const cpuset_t&
+        acceptor() const {
+            return m_acceptor;
+        }
+
+        virtual
+        const cpuset_t&
+        executors() const {
+            return m_executors;
+        }
+
+        virtual
+        size_t
+        workers() const {
+            return m_workers;
+        }
+
+        virtual
+        const cpuset_t&
+        interface() const {
+            return m_interface;
+        }
+
+        threads_t(const dynamic_t::object_t& source) {
+            const auto& engines = source.at("engines", dynamic_t::empty_array);
+
+            if(engines.is_string() && engines.as_string() == "numa") {
+                m_engines = cpuset_t::numa();
+
+                if(m_engines.empty()) {
+                    throw cocaine::error_t("NUMA topology is not available");
+                }
+            } else if(engines.is_string()) {
+                m_engines.push_back(parse(engines.as_string()));
+            } else if(engines.is_array()) {
+                for(const auto& cpus: engines.as_array()) {
+                    m_engines.push_back(parse(cpus.as_string()));
+                }
+            } else {
+                throw cocaine::error_t("\"engines\" section value should be either string or array of strings");
+            }
+
+            m_acceptor  = parse(source.at("acceptor", "").as_string());
+            m_executors = parse(source.at("executors", "").as_string());
+            m_workers   = source.at("workers", default_workers()).as_uint();
+
+            if(m_workers == 0) {
+                throw cocaine::error_t("executor must have at least one worker");
+            }
+
+            const auto interface = source.at("interface", "").as_string();
+
+            if(!interface.empty()) {
+                m_interface = cpuset_t::interface(interface);
+            }
+        }
+
+        // One worker per CPU, unless the number of CPUs can't be determined.
+        static
+        unsigned int
+        default_workers() {
+            const auto concurrency = boost::thread::hardware_concurrency();
+            return concurrency ? concurrency : defaults::executor_workers;
+        }
+
+        // Rejects sets with CPUs threads aren't allowed to run on, so that pinning never fails later.
+        static
+        cpuset_t
+        parse(const std::string& list) {
+            const cpuset_t cpus(list);
+            const cpuset_t allowed(cpuset_t::current());
+
+            if(!allowed.empty() && !allowed.contains(cpus)) {
+                throw cocaine::error_t("CPU set \"{}\" is not available, allowed CPUs are \"{}\"", list,
+                    allowed.string());
+            }
+
+            return cpus;
+        }
+
+        std::vector<cpuset_t> m_engines;
+        cpuset_t m_acceptor;
+        cpuset_t m_executors;
+        size_t m_workers;
+        cpuset_t m_interface;
     };
 
     struct logging_t : public config_t::logging_t {
@@ -275,15 +427,27 @@ public:
             return m_args;
         }
 
+        virtual
+        const dynamic_t&
+        network() const {
+            return m_network;
+        }
+
         component_t() {}
 
         component_t(const dynamic_t& source) :
             m_type(source.as_object().at("type", "unspecified").as_string()),
-            m_args(source.as_object().at("args", dynamic_t::empty_object))
-        {}
+            m_args(source.as_object().at("args", dynamic_t::empty_object)),
+            m_network(source.as_object().at("network", dynamic_t::empty_object))
+        {
+            if(!m_network.is_object()) {
+                throw cocaine::error_t("component network options must be an object");
+            }
+        }
 
         std::string m_type;
         dynamic_t   m_args;
+        dynamic_t   m_network;
     };
 
     typedef std::map<std::string, component_t> component_map_t;
@@ -337,6 +501,12 @@ public:
         return m_network;
     }
 
+    virtual
+    const threads_t&
+    threads() const {
+        return m_threads;
+    }
+
     virtual
     const logging_t&
     logging() const {
@@ -459,6 +629,7 @@ public:
         m_source(read_source_file(source_file)),
         m_path(m_source.as_object().at("paths", dynamic_t::empty_object).as_object()),
         m_network(m_source.as_object().at("network", dynamic_t::empty_object).as_object()),
+        m_threads(m_source.as_object().at("threads", dynamic_t::empty_object).as_object()),
         m_logging(m_source.as_object().at("logging", dynamic_t::empty_object).as_object()),
         component_groups(init_components_groups(m_source)),
         m_uuid(m_source.as_object().at("uuid", unique_id_t().string()).as_string())
@@ -468,6 +639,7 @@ public:
     dynamic_t m_source;
     path_t m_path;
     network_t m_network;
+    threads_t m_threads;
     logging_t m_logging;
     std::map<std::string, component_group_t> component_groups;
     std::string m_uuid;
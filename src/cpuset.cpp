@@ -0,0 +1,203 @@
+/*
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/cpuset.hpp"
+
+#include "cocaine/errors.hpp"
+#include "cocaine/format.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+#if defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+using namespace cocaine;
+
+namespace {
+
+// Reads the first line of a sysfs attribute, empty if it can't be read.
+auto
+read(const std::string& path) -> std::string {
+    std::ifstream stream(path);
+    std::string line;
+
+    std::getline(stream, line);
+
+    return line;
+}
+
+} // namespace
+
+cpuset_t::cpuset_t(const std::string& list) {
+    std::istringstream stream(list);
+    std::string range;
+
+    while(std::getline(stream, range, ',')) {
+        range.erase(std::remove_if(range.begin(), range.end(), ::isspace), range.end());
+
+        if(range.empty()) {
+            continue;
+        }
+
+        unsigned first, last;
+        char dash;
+
+        std::istringstream parser(range);
+
+        if(!(parser >> first)) {
+            throw cocaine::error_t("invalid CPU list \"{}\"", list);
+        }
+
+        if(parser >> dash) {
+            if(dash != '-' || !(parser >> last) || last < first) {
+                throw cocaine::error_t("invalid CPU list \"{}\"", list);
+            }
+        } else {
+            last = first;
+        }
+
+        if(!parser.eof()) {
+            throw cocaine::error_t("invalid CPU list \"{}\"", list);
+        }
+
+#if defined(__linux__)
+        if(last >= CPU_SETSIZE) {
+            throw cocaine::error_t("CPU {} in \"{}\" is out of range", last, list);
+        }
+#endif
+
+        for(unsigned cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+}
+
+auto
+cpuset_t::current() -> cpuset_t {
+    cpuset_t result;
+
+#if defined(__linux__)
+    cpu_set_t set;
+
+    if(::pthread_getaffinity_np(::pthread_self(), sizeof(set), &set) != 0) {
+        return result;
+    }
+
+    for(unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if(CPU_ISSET(cpu, &set)) {
+            result.cpus.push_back(cpu);
+        }
+    }
+#endif
+
+    return result;
+}
+
+auto
+cpuset_t::numa() -> std::vector<cpuset_t> {
+    std::vector<cpuset_t> result;
+
+    // Node numbers are listed in the same format as CPUs.
+    const auto nodes = cpuset_t(read("/sys/devices/system/node/online"));
+
+    for(auto it = nodes.cpus.begin(); it != nodes.cpus.end(); ++it) {
+        cpuset_t cpus(read(cocaine::format("/sys/devices/system/node/node{}/cpulist", *it)));
+
+        // Memory-only nodes have no CPUs at all.
+        if(!cpus.empty()) {
+            result.push_back(std::move(cpus));
+        }
+    }
+
+    return result;
+}
+
+auto
+cpuset_t::interface(const std::string& name) -> cpuset_t {
+    int node = -1;
+
+    std::istringstream(read(cocaine::format("/sys/class/net/{}/device/numa_node", name))) >> node;
+
+    if(node < 0) {
+        return cpuset_t();
+    }
+
+    return cpuset_t(read(cocaine::format("/sys/devices/system/node/node{}/cpulist", node)));
+}
+
+auto
+cpuset_t::contains(const cpuset_t& other) const -> bool {
+    return std::includes(cpus.begin(), cpus.end(), other.cpus.begin(), other.cpus.end());
+}
+
+auto
+cpuset_t::apply() const -> std::error_code {
+    if(cpus.empty()) {
+        return std::error_code();
+    }
+
+#if defined(__linux__)
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+
+    for(auto it = cpus.begin(); it != cpus.end(); ++it) {
+        CPU_SET(*it, &set);
+    }
+
+    return std::error_code(::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set), std::system_category());
+#else
+    return std::make_error_code(std::errc::not_supported);
+#endif
+}
+
+auto
+cpuset_t::string() const -> std::string {
+    std::ostringstream stream;
+
+    for(auto it = cpus.begin(); it != cpus.end();) {
+        auto last = it;
+
+        while(last + 1 != cpus.end() && *(last + 1) == *last + 1) {
+            ++last;
+        }
+
+        if(it != cpus.begin()) {
+            stream << ',';
+        }
+
+        stream << *it;
+
+        if(last != it) {
+            stream << '-' << *last;
+        }
+
+        it = last + 1;
+    }
+
+    return stream.str();
+}
@@ -54,23 +54,266 @@ decoded_message_t::headers() const -> const hpack::headers_t& {
     return metadata;
 }
 
+auto
+decoded_message_t::buffer() const -> const std::shared_ptr<const void>& {
+    return owner;
+}
+
+void
+decoded_message_t::attach(std::shared_ptr<const void> buffer) {
+    owner = std::move(buffer);
+}
+
 void
 decoded_message_t::clear() {
     metadata.clear();
+    owner.reset();
+}
+
+namespace {
+
+uint64_t
+load_be(const char* data, size_t size) {
+    uint64_t result = 0;
+
+    for(size_t i = 0; i < size; ++i) {
+        result = (result << 8) | static_cast<unsigned char>(data[i]);
+    }
+
+    return result;
+}
+
+} // namespace
+
+frame_scanner_t::frame_scanner_t(size_t limit_):
+    limit(limit_)
+{
+    reset();
+}
+
+bool
+frame_scanner_t::scan(const char* data, size_t size, std::error_code& ec) {
+    while(offset < size) {
+        if(skip) {
+            const size_t chunk = std::min<size_t>(skip, size - offset);
+
+            offset += chunk;
+            skip   -= chunk;
+
+            if(skip) {
+                break;
+            } else if(complete()) {
+                return true;
+            }
+
+            continue;
+        }
+
+        const unsigned char type = static_cast<unsigned char>(data[offset]);
+
+        // Size of the type header following the type byte, payload size or element count.
+        size_t extra = 0;
+        uint64_t length = 0;
+        uint64_t elements = 0;
+
+        // Number of the type header bytes containing the length, zero for fixed size types.
+        size_t length_bytes = 0;
+
+        // Whether the length is an element count, and each of the elements is a key-value pair.
+        bool container = false, pairs = false;
+
+        if(type <= 0x7F || type >= 0xE0 || type == 0xC0 || type == 0xC2 || type == 0xC3) {
+            // Fixints, nil and booleans.
+        } else if(type <= 0x8F) {
+            container = pairs = true;
+            elements = type & 0x0F;
+        } else if(type <= 0x9F) {
+            container = true;
+            elements = type & 0x0F;
+        } else if(type <= 0xBF) {
+            length = type & 0x1F;
+        } else switch(type) {
+        case 0xC4: case 0xC5: case 0xC6:
+            extra = length_bytes = 1 << (type - 0xC4);
+            break;
+        case 0xC7: case 0xC8: case 0xC9:
+            // Extension type byte follows the length.
+            length_bytes = 1 << (type - 0xC7);
+            extra = length_bytes + 1;
+            break;
+        case 0xCA: case 0xCB:
+            length = type == 0xCA ? 4 : 8;
+            break;
+        case 0xCC: case 0xCD: case 0xCE: case 0xCF:
+            length = 1 << (type - 0xCC);
+            break;
+        case 0xD0: case 0xD1: case 0xD2: case 0xD3:
+            length = 1 << (type - 0xD0);
+            break;
+        case 0xD4: case 0xD5: case 0xD6: case 0xD7: case 0xD8:
+            // Extension type byte plus fixed size payload.
+            length = 1 + (1 << (type - 0xD4));
+            break;
+        case 0xD9: case 0xDA: case 0xDB:
+            extra = length_bytes = 1 << (type - 0xD9);
+            break;
+        case 0xDC: case 0xDD:
+            container = true;
+            extra = length_bytes = type == 0xDC ? 2 : 4;
+            break;
+        case 0xDE: case 0xDF:
+            container = pairs = true;
+            extra = length_bytes = type == 0xDE ? 2 : 4;
+            break;
+        default:
+            // Reserved.
+            ec = error::parse_error;
+            return false;
+        }
+
+        if(offset + 1 + extra > size) {
+            // The type header itself is split, wait for the rest of it.
+            break;
+        }
+
+        if(length_bytes) {
+            (container ? elements : length) = load_be(data + offset + 1, length_bytes);
+        }
+
+        offset += 1 + extra;
+
+        if(container) {
+            if(pairs) {
+                elements *= 2;
+            }
+
+            nested += elements;
+
+            if(elements) {
+                if(depth == kMaxDepth) {
+                    ec = error::parse_error;
+                    return false;
+                }
+
+                pending[depth++] = elements;
+            }
+        } else {
+            skip = length;
+        }
+
+        // NOTE: Only explicitly declared lengths can be large enough to exceed the limit, while the
+        // frame size is only known to be at least that big.
+        if(length_bytes && expected() > limit) {
+            ec = error::frame_too_large;
+            return false;
+        }
+
+        if(container ? elements != 0 : length != 0) {
+            continue;
+        }
+
+        if(complete()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+auto
+frame_scanner_t::size() const -> size_t {
+    return offset;
+}
+
+auto
+frame_scanner_t::expected() const -> size_t {
+    // Every pending element takes at least one byte. Elements being scanned right now, i.e. nested
+    // containers and the partially skipped one, are already accounted for.
+    size_t result = offset + skip;
+
+    for(size_t i = 0; i < depth; ++i) {
+        result += pending[i] - ((i + 1 < depth || skip) ? 1 : 0);
+    }
+
+    return result;
+}
+
+auto
+frame_scanner_t::objects() const -> size_t {
+    return nested;
+}
+
+void
+frame_scanner_t::reset() {
+    offset = skip = nested = depth = 0;
+}
+
+bool
+frame_scanner_t::complete() {
+    while(depth) {
+        if(--pending[depth - 1]) {
+            return false;
+        }
+
+        --depth;
+    }
+
+    return true;
 }
 
 } // namespace aux
 
+const size_t decoder_t::kShrinkAfter;
+
+decoder_t::decoder_t(size_t zone_limit_, size_t frame_limit):
+    zone(new msgpack::zone(MSGPACK_ZONE_CHUNK_SIZE)),
+    zone_size(MSGPACK_ZONE_CHUNK_SIZE),
+    zone_limit(zone_limit_),
+    small_frames(0),
+    scanner(frame_limit)
+{ }
+
+decoder_t::~decoder_t() = default;
+
 size_t
 decoder_t::decode(const char* data, size_t size, message_type& message, std::error_code& ec) {
+    if(!scanner.scan(data, size, ec)) {
+        if(ec) {
+            scanner.reset();
+        } else {
+            ec = error::insufficient_bytes;
+        }
+
+        return 0;
+    }
+
     size_t offset = 0;
+    const size_t frame_size = scanner.size();
+
+    // Strings are referenced in place, so container elements are the only thing allocated.
+    const size_t zone_bytes = scanner.objects() * sizeof(msgpack::object);
+
+    scanner.reset();
 
     // NOTE: We have to clear msgpack zone every decoding iteration to prevent memory leaking
     // for objects structure, because they have no way to notify about self-destruction. Hope
     // someday we migrate to v1.* and everything will be fine automatically.
-    zone.clear();
+    small_frames = zone_bytes <= MSGPACK_ZONE_CHUNK_SIZE ? small_frames + 1 : 0;
 
-    msgpack::unpack_return rv = msgpack::unpack(data, size, &offset, &zone, &message.object);
+    if(zone_bytes > zone_size && zone_bytes <= zone_limit) {
+        // Grow geometrically, so that slowly growing frames don't replace the zone every time.
+        zone_size = std::min(std::max(zone_bytes, zone_size * 2), zone_limit);
+        zone.reset(new msgpack::zone(zone_size));
+    } else if(zone_size > MSGPACK_ZONE_CHUNK_SIZE && small_frames >= kShrinkAfter) {
+        // Large frames seem to be over, give the memory back.
+        zone_size = MSGPACK_ZONE_CHUNK_SIZE;
+        zone.reset(new msgpack::zone(zone_size));
+    } else {
+        zone->clear();
+    }
+
+    // The frame is known to be complete at this point, so it's unpacked exactly once.
+    msgpack::unpack_return rv = msgpack::unpack(data, frame_size, &offset, zone.get(), &message.object);
 
     if(rv == msgpack::UNPACK_SUCCESS || rv == msgpack::UNPACK_EXTRA_BYTES) {
         if(message.object.type != msgpack::type::ARRAY || message.object.via.array.size < 3) {
@@ -89,13 +332,22 @@ decoder_t::decode(const char* data, size_t size, message_type& message, std::err
                 ec = error::hpack_error;
             }
         }
-    } else if(rv == msgpack::UNPACK_CONTINUE) {
-        ec = error::insufficient_bytes;
-    } else if(rv == msgpack::UNPACK_PARSE_ERROR) {
+    } else {
+        // Even UNPACK_CONTINUE means a malformed frame here, as the scanner has already seen it all.
         ec = error::parse_error;
     }
 
     return offset;
 }
 
+auto
+decoder_t::expected() const -> size_t {
+    return scanner.expected();
+}
+
+auto
+decoder_t::retained() const -> size_t {
+    return zone_size;
+}
+
 }} // namespace cocaine::io
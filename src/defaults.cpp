@@ -26,6 +26,10 @@ const std::string defaults::plugins_path  = "/usr/lib/cocaine";
 const std::string defaults::runtime_path  = "/var/run/cocaine";
 
 const std::string defaults::endpoint      = "::";
+const unsigned int defaults::pull_budget  = 64;
+const unsigned int defaults::flush_batch  = 256;
+
+const unsigned int defaults::executor_workers = 4;
 
 const std::string defaults::log_verbosity = "info";
 const std::string defaults::log_timestamp = "%Y-%m-%d %H:%M:%S.%f";
\ No newline at end of file
@@ -22,6 +22,8 @@
 
 #include "cocaine/errors.hpp"
 
+#include <boost/optional/optional.hpp>
+
 using namespace cocaine::io;
 
 basic_dispatch_t::basic_dispatch_t(const std::string& name):
@@ -35,6 +37,27 @@ basic_dispatch_t::~basic_dispatch_t() {
 auto
 basic_dispatch_t::attached(std::shared_ptr<session_t>) -> void {}
 
+boost::optional<dispatch_ptr_t>
+basic_dispatch_t::try_process(const decoder_t::message_type& message, const upstream_ptr_t& upstream,
+                              std::error_code& COCAINE_UNUSED_(ec))
+{
+    // NOTE: Exceptions are not translated, since it's not known which of them are rejections. The
+    // exception message often tells more than the error code does, so the session logs it as is.
+    return process(message, upstream);
+}
+
+auto
+basic_dispatch_t::rejection(int id, const std::error_code& ec) const -> std::system_error {
+    const auto& graph = root();
+    const auto it = graph.find(id);
+
+    if(it == graph.end()) {
+        return std::system_error(ec);
+    }
+
+    return std::system_error(ec, std::get<0>(it->second));
+}
+
 void
 basic_dispatch_t::discard(const std::error_code& COCAINE_UNUSED_(ec)) {
     // Empty.
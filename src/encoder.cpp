@@ -34,6 +34,7 @@
 #include "cocaine/traits.hpp"
 #include "cocaine/traits/tuple.hpp"
 
+#include <algorithm>
 #include <cstring>
 
 namespace cocaine {
@@ -41,34 +42,214 @@ namespace io {
 
 namespace aux {
 
+buffer_pool_t::~buffer_pool_t() {
+    for(auto& idle: m_idle) {
+        for(char* data: idle) {
+            delete[] data;
+        }
+    }
+}
+
+char*
+buffer_pool_t::acquire(size_t& capacity) {
+    size_t size_class = 0;
+    size_t class_size = kMinClassSize;
+
+    while(class_size < capacity && size_class < kClassCount) {
+        class_size *= 2;
+        size_class += 1;
+    }
+
+    if(size_class == kClassCount) {
+        // Too large to be pooled.
+        return new char[capacity];
+    }
+
+    capacity = class_size;
+
+    auto& idle = m_idle[size_class];
+
+    if(idle.empty()) {
+        return new char[capacity];
+    }
+
+    char* data = idle.back();
+    idle.pop_back();
+
+    m_idle_bytes -= capacity;
+
+    return data;
+}
+
+void
+buffer_pool_t::release(char* data, size_t capacity) {
+    size_t size_class = 0;
+    size_t class_size = kMinClassSize;
+
+    while(class_size < capacity && size_class < kClassCount) {
+        class_size *= 2;
+        size_class += 1;
+    }
+
+    if(size_class == kClassCount || class_size != capacity) {
+        delete[] data;
+        return;
+    }
+
+    const size_t limit = std::max<size_t>(kMaxIdle >> size_class, 1);
+
+    if(m_idle[size_class].size() >= limit || m_idle_bytes + capacity > kMaxIdleBytes) {
+        delete[] data;
+    } else {
+        m_idle[size_class].push_back(data);
+        m_idle_bytes += capacity;
+    }
+}
+
 encoded_buffers_t::encoded_buffers_t() :
-offset(0) {
-    vector.resize(kInitialBufferSize);
+    buffer(nullptr),
+    capacity(0),
+    offset(0)
+{}
+
+encoded_buffers_t::encoded_buffers_t(std::shared_ptr<buffer_pool_t> pool_, size_t size) :
+    pool(std::move(pool_)),
+    capacity(size),
+    offset(0)
+{
+    buffer = pool ? pool->acquire(capacity) : new char[capacity];
+}
+
+encoded_buffers_t::~encoded_buffers_t() {
+    reset();
+}
+
+encoded_buffers_t::encoded_buffers_t(encoded_buffers_t&& other) :
+    pool(std::move(other.pool)),
+    buffer(other.buffer),
+    capacity(other.capacity),
+    offset(other.offset),
+    segments(std::move(other.segments)),
+    pinned(std::move(other.pinned)),
+    owners(std::move(other.owners))
+{
+    other.buffer = nullptr;
+    other.capacity = other.offset = 0;
+}
+
+encoded_buffers_t&
+encoded_buffers_t::operator=(encoded_buffers_t&& other) {
+    if(this != &other) {
+        reset();
+
+        pool = std::move(other.pool);
+        buffer = other.buffer;
+        capacity = other.capacity;
+        offset = other.offset;
+
+        segments = std::move(other.segments);
+        pinned = std::move(other.pinned);
+        owners = std::move(other.owners);
+
+        other.buffer = nullptr;
+        other.capacity = other.offset = 0;
+    }
+
+    return *this;
+}
+
+void
+encoded_buffers_t::reset() {
+    if(buffer == nullptr) {
+        return;
+    }
+
+    if(pool) {
+        pool->release(buffer, capacity);
+    } else {
+        delete[] buffer;
+    }
+
+    buffer = nullptr;
 }
 
 void
 encoded_buffers_t::write(const char* data, size_t size) {
-    size_t new_size = vector.size();
-    while (size > new_size - offset) {
-        new_size *= 2;
+    if(size >= kReferenceThreshold) {
+        for(auto it = pinned.begin(); it != pinned.end(); ++it) {
+            if(it->data == data && it->size == size && !it->referenced) {
+                it->referenced = true;
+                segments.push_back(segment_t{offset, data, size});
+                return;
+            }
+        }
+    }
+
+    if(size > capacity - offset) {
+        size_t new_capacity = std::max<size_t>(capacity, kInitialBufferSize);
+
+        while(size > new_capacity - offset) {
+            new_capacity *= 2;
+        }
+
+        char* new_buffer = pool ? pool->acquire(new_capacity) : new char[new_capacity];
+
+        if(offset) {
+            std::memcpy(new_buffer, buffer, offset);
+        }
+
+        reset();
+
+        buffer = new_buffer;
+        capacity = new_capacity;
     }
-    vector.resize(new_size);
 
-    std::memcpy(vector.data() + offset, data, size);
+    std::memcpy(buffer + offset, data, size);
 
     offset += size;
 }
 
+void
+encoded_buffers_t::pin(const char* data, size_t size) {
+    pinned.push_back(pinned_t{data, size, false});
+}
+
+bool
+encoded_buffers_t::referenced(const char* data) const {
+    for(auto it = pinned.begin(); it != pinned.end(); ++it) {
+        if(it->data == data) {
+            return it->referenced;
+        }
+    }
+
+    return false;
+}
+
+void
+encoded_buffers_t::retain(std::shared_ptr<const void> owner) {
+    owners.push_back(std::move(owner));
+}
+
 auto
 encoded_buffers_t::data() const -> const char* {
-    return vector.data();
+    return buffer;
 }
 
 size_t
 encoded_buffers_t::size() const {
-    return offset;
+    size_t total = offset;
+
+    for(auto it = segments.begin(); it != segments.end(); ++it) {
+        total += it->size;
+    }
+
+    return total;
 }
 
+encoded_message_t::encoded_message_t(std::shared_ptr<buffer_pool_t> pool, size_t size) :
+    buffer(std::move(pool), size)
+{}
+
 void
 encoded_message_t::write(const char* data, size_t size) {
     return buffer.write(data, size);
@@ -88,6 +269,35 @@ unbound_message_t::unbound_message_t(function_type&& bind_): bind(std::move(bind
 
 } //  namespace aux
 
+const size_t aux::encoded_buffers_t::kInitialBufferSize;
+const size_t aux::encoded_buffers_t::kReferenceThreshold;
+
+const size_t aux::buffer_pool_t::kMinClassSize;
+const size_t aux::buffer_pool_t::kClassCount;
+const size_t aux::buffer_pool_t::kMaxIdle;
+const size_t aux::buffer_pool_t::kMaxIdleBytes;
+
+const size_t encoder_t::kFrameOverhead;
+const size_t encoder_t::kArgumentsOverhead;
+
+encoder_t::encoder_t() :
+    pool(std::make_shared<aux::buffer_pool_t>())
+{}
+
+size_t
+encoder_t::estimate_headers(const hpack::headers_t& headers) {
+    // Array header and three tracing headers, each of which is at most a literal with an indexed name
+    // and an 8-byte value.
+    size_t total = 5 + 3 * 24;
+
+    for(const auto& header: headers) {
+        // Array header, indexing flag, name and value raw headers.
+        total += 1 + 1 + 5 + header.name().size() + 5 + header.value_size();
+    }
+
+    return total;
+}
+
 void
 encoder_t::pack_headers(packer_type& packer, const hpack::headers_t& headers) {
 
@@ -106,9 +316,20 @@ encoder_t::pack_headers(packer_type& packer, const hpack::headers_t& headers) {
     uint64_t span_id   = trace_t::current().get_id();
     uint64_t parent_id = trace_t::current().get_parent_id();
 
-    hpack::msgpack_traits::pack<hpack::headers::trace_id<>>(packer, hpack_context, hpack::header::pack(trace_id));
-    hpack::msgpack_traits::pack<hpack::headers::span_id<>>(packer, hpack_context, hpack::header::pack(span_id));
-    hpack::msgpack_traits::pack<hpack::headers::parent_id<>>(packer, hpack_context, hpack::header::pack(parent_id));
+    if(compression) {
+        typedef hpack::msgpack_traits traits;
+        typedef hpack::headers h;
+
+        // Trace id is shared by all the spans of a trace, so it's likely to be seen again, whereas
+        // span ids are unique and would only pollute the table.
+        traits::pack_compressed(packer, hpack_context, hpack::header_t::create<h::trace_id<>>(hpack::header::pack(trace_id)));
+        traits::pack_unindexed(packer, hpack_context, hpack::header_t::create<h::span_id<>>(hpack::header::pack(span_id)));
+        traits::pack_unindexed(packer, hpack_context, hpack::header_t::create<h::parent_id<>>(hpack::header::pack(parent_id)));
+    } else {
+        hpack::msgpack_traits::pack<hpack::headers::trace_id<>>(packer, hpack_context, hpack::header::pack(trace_id));
+        hpack::msgpack_traits::pack<hpack::headers::span_id<>>(packer, hpack_context, hpack::header::pack(span_id));
+        hpack::msgpack_traits::pack<hpack::headers::parent_id<>>(packer, hpack_context, hpack::header::pack(parent_id));
+    }
 
     for (const auto& header: headers) {
         // Skip packing outdated tracing headers. We use fresh ones (shifted on the tracing tree) from TLS.
@@ -117,10 +338,25 @@ encoder_t::pack_headers(packer_type& packer, const hpack::headers_t& headers) {
         if(name == h::trace_id<>::name() || name == h::span_id<>::name() || name == h::parent_id<>::name()) {
             continue;
         }
-        hpack::msgpack_traits::pack(packer, hpack_context, header);
+
+        if(compression) {
+            hpack::msgpack_traits::pack_compressed(packer, hpack_context, header);
+        } else {
+            hpack::msgpack_traits::pack(packer, hpack_context, header);
+        }
     }
 }
 
+void
+encoder_t::set_compression(bool enable) {
+    compression = enable;
+}
+
+auto
+encoder_t::compressed() const -> bool {
+    return compression;
+}
+
 aux::encoded_message_t
 encoder_t::encode(const message_type& message) {
     return message.bind(*this);
@@ -21,16 +21,19 @@
 #include "cocaine/engine.hpp"
 
 #include "cocaine/context.hpp"
+#include "cocaine/context/config.hpp"
+#include "cocaine/cpuset.hpp"
+#include "cocaine/dynamic.hpp"
+#include "cocaine/format/endpoint.hpp"
 #include "cocaine/logging.hpp"
 
 #include "cocaine/rpc/asio/transport.hpp"
+#include "cocaine/rpc/asio/uring.hpp"
 #include "cocaine/rpc/basic_dispatch.hpp"
 #include "cocaine/rpc/session.hpp"
+#include "cocaine/trace/logger.hpp"
 
 #include <blackhole/logger.hpp>
-#include <blackhole/wrapper.hpp>
-
-#include <boost/lexical_cast.hpp>
 
 #include <asio/io_service.hpp>
 #include <asio/ip/tcp.hpp>
@@ -43,6 +46,31 @@ using namespace cocaine::io;
 
 using namespace asio;
 
+namespace {
+
+auto
+peer_of(const ip::tcp::socket& socket) -> ip::tcp::endpoint {
+    return socket.remote_endpoint();
+}
+
+auto
+peer_of(const local::stream_protocol::socket& socket) -> local::stream_protocol::endpoint {
+    // Local sockets are described by the path they are bound to.
+    return socket.local_endpoint();
+}
+
+auto
+describe(const ip::tcp::endpoint& endpoint) -> std::string {
+    return cocaine::format("{}", endpoint);
+}
+
+auto
+describe(const local::stream_protocol::endpoint& endpoint) -> std::string {
+    return endpoint.path();
+}
+
+} // namespace
+
 class execution_unit_t::gc_action_t:
     public std::enable_shared_from_this<gc_action_t>
 {
@@ -103,10 +131,11 @@ execution_unit_t::gc_action_t::finalize(const std::error_code& ec) {
     operator()();
 }
 
-execution_unit_t::execution_unit_t(context_t& context):
+execution_unit_t::execution_unit_t(context_t& context, const cpuset_t& cpus):
     m_asio(new io_service()),
-    m_chamber(new chamber_t("core/asio", m_asio)),
+    m_chamber(new chamber_t("core/asio", m_asio, cpus)),
     m_log(context.log("core/asio", {{"engine", m_chamber->thread_id()}})),
+    m_session_log(context.log("core/asio/session", {{"engine", m_chamber->thread_id()}})),
     m_metrics(context.metrics_hub()),
     m_cron(new asio::deadline_timer(*m_asio)),
     context(context)
@@ -115,7 +144,19 @@ execution_unit_t::execution_unit_t(context_t& context):
         std::make_shared<gc_action_t>(this, boost::posix_time::seconds(kCollectionInterval))
     ));
 
-    COCAINE_LOG_DEBUG(m_log, "engine started");
+    if(context.config().network().transport() == "uring") {
+        try {
+            m_uring = std::make_shared<io::uring_t>(*m_asio);
+        } catch(const std::system_error& e) {
+            COCAINE_LOG_WARNING(m_log, "unable to use io_uring, falling back to asio: {}", e.what());
+        }
+    }
+
+    if(cpus.empty()) {
+        COCAINE_LOG_DEBUG(m_log, "engine started");
+    } else {
+        COCAINE_LOG_DEBUG(m_log, "engine started on CPUs {}", cpus.string());
+    }
 }
 
 execution_unit_t::~execution_unit_t() {
@@ -136,12 +177,89 @@ execution_unit_t::~execution_unit_t() {
     m_chamber = nullptr;
 }
 
+struct execution_unit_t::options_t {
+    // Zero bytes means no coalescing at all.
+    std::size_t coalescing_bytes;
+    boost::posix_time::time_duration coalescing_latency;
+
+    // Zero high watermark means no watermarks at all.
+    std::size_t low;
+    std::size_t high;
+    std::size_t limit;
+
+    std::size_t channels;
+
+    options_t():
+        coalescing_bytes(0),
+        low(0),
+        high(0),
+        limit(0),
+        channels(0)
+    { }
+};
+
+auto
+execution_unit_t::options(const std::string& service) const -> const options_t& {
+    return m_options.apply([&](std::map<std::string, std::unique_ptr<options_t>>& map) -> const options_t& {
+        auto it = map.find(service);
+
+        if(it != map.end()) {
+            return *it->second;
+        }
+
+        auto options = std::make_unique<options_t>();
+
+        if(const auto component = context.config().services().get(service)) {
+            const auto& network = component->network().as_object();
+
+            const auto& coalescing = network.at("coalescing", dynamic_t::empty_object).as_object();
+
+            if(!coalescing.empty()) {
+                // Latency is specified in microseconds, zero means coalescing within the reactor turn.
+                options->coalescing_bytes = coalescing.at("bytes", 65536u).as_uint();
+                options->coalescing_latency = boost::posix_time::microseconds(
+                    coalescing.at("latency", 0u).as_uint()
+                );
+            }
+
+            const auto& watermarks = network.at("watermarks", dynamic_t::empty_object).as_object();
+
+            if(!watermarks.empty()) {
+                options->high  = watermarks.at("high", 0u).as_uint();
+                options->low   = watermarks.at("low", options->high / 2).as_uint();
+                options->limit = watermarks.at("limit", 0u).as_uint();
+            }
+
+            // Maximum number of channels a client can keep open, new channels over the limit are
+            // refused.
+            options->channels = network.at("channels", 0u).as_uint();
+        }
+
+        return *map.emplace(service, std::move(options)).first->second;
+    });
+}
+
+void
+execution_unit_t::configure(session_t& session, const std::string& service) const {
+    const auto& options = this->options(service);
+
+    if(options.coalescing_bytes) {
+        session.set_coalescing(options.coalescing_bytes, options.coalescing_latency);
+    }
+
+    if(options.high) {
+        session.set_watermarks(options.low, options.high, options.limit);
+    }
+
+    session.set_max_channels(options.channels);
+}
+
 template<class Socket>
 std::shared_ptr<session<typename Socket::protocol_type>>
 execution_unit_t::attach(std::unique_ptr<Socket> ptr, const dispatch_ptr_t& dispatch) {
-    typedef Socket socket_type;
-    typedef typename socket_type::protocol_type protocol_type;
-    typedef session<protocol_type> session_type;
+    if(&ptr->get_io_service() == m_asio.get()) {
+        return launch(std::move(ptr), dispatch);
+    }
 
     int fd;
 
@@ -149,18 +267,51 @@ execution_unit_t::attach(std::unique_ptr<Socket> ptr, const dispatch_ptr_t& disp
         throw std::system_error(errno, std::system_category(), "unable to clone client's socket");
     }
 
-    std::shared_ptr<session_type> session_;
+    std::error_code ec;
+
+    // Local endpoint address of the socket to be cloned.
+    const auto endpoint = ptr->local_endpoint(ec);
+
+    if(ec) {
+        ::close(fd);
+        throw std::system_error(ec, "client has disappeared while creating session");
+    }
+
+    return attach(endpoint.protocol(), fd, dispatch);
+}
+
+template<class Protocol>
+std::shared_ptr<session<Protocol>>
+execution_unit_t::attach(const Protocol& protocol, int fd, const dispatch_ptr_t& dispatch) {
+    typedef typename Protocol::socket socket_type;
+
+    std::unique_ptr<socket_type> ptr;
 
     try {
-        // Local endpoint address of the socket to be cloned.
-        const auto endpoint = ptr->local_endpoint();
+        ptr = std::make_unique<socket_type>(*m_asio, protocol, fd);
+    } catch(const std::system_error& e) {
+        ::close(fd);
+        throw std::system_error(e.code(), "unable to assign client's socket");
+    }
+
+    return launch(std::move(ptr), dispatch);
+}
+
+template<class Socket>
+std::shared_ptr<session<typename Socket::protocol_type>>
+execution_unit_t::launch(std::unique_ptr<Socket> ptr, const dispatch_ptr_t& dispatch) {
+    typedef typename Socket::protocol_type protocol_type;
+    typedef session<protocol_type> session_type;
+
+    const int fd = ptr->native_handle();
+
+    std::shared_ptr<session_type> session_;
 
-        // Copy the socket into the new reactor.
-        auto transport = std::make_unique<io::transport<protocol_type>>(
-            std::make_unique<socket_type>(*m_asio, endpoint.protocol(), fd)
-        );
+    try {
+        // Remote endpoint address for the logs.
+        const auto peer = peer_of(*ptr);
 
-        std::string remote_endpoint;
+        auto transport = std::make_unique<io::transport<protocol_type>>(std::move(ptr), m_uring);
 
         if(std::is_same<protocol_type, ip::tcp>::value) {
             // Disable Nagle's algorithm, since most of the service clients do not send or receive
@@ -173,23 +324,37 @@ execution_unit_t::attach(std::unique_ptr<Socket> ptr, const dispatch_ptr_t& disp
             // NOTE: There is another solution: with reading `null_buffers` every N seconds we can
             // check an error code received.
             transport->socket->set_option(asio::socket_base::keep_alive(true));
-            remote_endpoint = boost::lexical_cast<std::string>(ptr->remote_endpoint());
-        } else if(std::is_same<protocol_type, local::stream_protocol>::value) {
-            remote_endpoint = boost::lexical_cast<std::string>(endpoint);
-        } else {
-            remote_endpoint = "<unknown>";
         }
 
-        auto log = context.log("core/asio/session", {
-            {"endpoint", remote_endpoint                       },
-            {"service",  dispatch ? dispatch->name() : "<none>"},
-            {"engine", m_chamber->thread_id()}
+        transport->writer->encoder().set_compression(context.config().network().compression());
+
+        // The gate drops records nobody listens to before the attributes are ever built. It refers
+        // to the context rather than to the engine, since sessions might outlive the engine.
+        context_t* parent = &context;
+
+        auto gate = [parent](blackhole::severity_t severity) {
+            return parent->logger_enabled(severity);
+        };
+
+        // NOTE: The endpoint is fetched right away, while the socket is surely alive, but neither it
+        // nor the service name is formatted unless the session actually logs something.
+        auto log = std::make_unique<logging::lazy_wrapper_t>(m_session_log, gate, [=]() -> blackhole::attributes_t {
+            return {
+                {"endpoint", describe(peer)                         },
+                {"service",  dispatch ? dispatch->name() : "<none>"}
+            };
         });
 
-        COCAINE_LOG_DEBUG(log, "attached connection to engine, load: {:.2f}%", utilization() * 100);
+        COCAINE_LOG_DEBUG(m_log, "attached connection to engine, load: {:.2f}%", utilization() * 100);
 
         // Create a new inactive session.
         session_ = std::make_shared<session_type>(std::move(log), m_metrics, std::move(transport), dispatch);
+        session_->set_budget(context.config().network().budget());
+        session_->set_batch(context.config().network().batch());
+
+        if(dispatch) {
+            configure(*session_, dispatch->name());
+        }
 
         // Start pulling right now to prevent race when session is detached before pull
         session_->pull();
@@ -204,6 +369,23 @@ execution_unit_t::attach(std::unique_ptr<Socket> ptr, const dispatch_ptr_t& disp
     return session_;
 }
 
+template<class Protocol>
+std::unique_ptr<typename Protocol::acceptor>
+execution_unit_t::expose(const typename Protocol::endpoint& endpoint) {
+    typedef typename Protocol::acceptor acceptor_type;
+    typedef asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port;
+
+    auto acceptor = std::make_unique<acceptor_type>(*m_asio);
+
+    acceptor->open(endpoint.protocol());
+    acceptor->set_option(socket_base::reuse_address(true));
+    acceptor->set_option(reuse_port(true));
+    acceptor->bind(endpoint);
+    acceptor->listen();
+
+    return acceptor;
+}
+
 double
 execution_unit_t::utilization() const {
     return m_chamber->load_avg1();
@@ -216,3 +398,19 @@ execution_unit_t::attach(std::unique_ptr<ip::tcp::socket>, const dispatch_ptr_t&
 template
 std::shared_ptr<session<local::stream_protocol>>
 execution_unit_t::attach(std::unique_ptr<local::stream_protocol::socket>, const dispatch_ptr_t&);
+
+template
+std::shared_ptr<session<ip::tcp>>
+execution_unit_t::attach(const ip::tcp&, int, const dispatch_ptr_t&);
+
+template
+std::shared_ptr<session<local::stream_protocol>>
+execution_unit_t::attach(const local::stream_protocol&, int, const dispatch_ptr_t&);
+
+template
+std::unique_ptr<ip::tcp::acceptor>
+execution_unit_t::expose<ip::tcp>(const ip::tcp::endpoint&);
+
+template
+std::unique_ptr<local::stream_protocol::acceptor>
+execution_unit_t::expose<local::stream_protocol>(const local::stream_protocol::endpoint&);
@@ -68,6 +68,10 @@ class transport_category_t:
             return "insufficient bytes provided to decode the message";
         case cocaine::error::transport_errors::parse_error:
             return "unable to parse the incoming data";
+        case cocaine::error::transport_errors::slow_consumer:
+            return "remote peer doesn't keep up with the outgoing data";
+        case cocaine::error::transport_errors::frame_too_large:
+            return "message exceeds the maximum frame size";
         default:
             return "cocaine.rpc.transport error";
         }
@@ -89,6 +93,8 @@ class protocol_category_t:
         switch(code) {
             case cocaine::error::protocol_errors::closed_upstream:
                 return "protocol violation - upstream was already closed";
+            case cocaine::error::protocol_errors::congested_upstream:
+                return "upstream is congested, retry when it becomes writable";
             default:
                 return "cocaine.rpc.protocol error";
         }
@@ -122,6 +128,8 @@ class dispatch_category_t:
             return "no dispatch has been assigned for channel";
         case cocaine::error::dispatch_errors::uncaught_error:
             return "uncaught invocation exception";
+        case cocaine::error::dispatch_errors::refused_channel:
+            return "too many channels are open";
         default:
             return "cocaine.rpc.dispatch error";
         }
@@ -4,9 +4,16 @@ namespace cocaine {
 namespace executor {
 
 owning_asio_t::owning_asio_t(stop_policy_t policy):
+    owning_asio_t(cpuset_t(), policy)
+{}
+
+owning_asio_t::owning_asio_t(const cpuset_t& cpus, stop_policy_t policy):
     io_loop(),
     work(asio::io_service::work(io_loop)),
-    thread([&](){ io_loop.run(); }),
+    thread([=](){
+        cpus.apply();
+        io_loop.run();
+    }),
     stop_policy(policy)
 {}
 
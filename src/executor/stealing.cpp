@@ -0,0 +1,211 @@
+#include "cocaine/executor/stealing.hpp"
+
+#include "cocaine/errors.hpp"
+#include "cocaine/format.hpp"
+#include "cocaine/utility/sharded_counter.hpp"
+
+#include <metrics/registry.hpp>
+
+#include <deque>
+
+namespace cocaine {
+namespace executor {
+
+struct stealing_t::worker_t {
+    std::mutex mutex;
+    std::deque<work_t> queue;
+};
+
+struct stealing_t::counters_t {
+    // Callbacks spawned, but not yet taken by any worker. Exact, as idle workers rely on it.
+    std::atomic<std::int64_t> pending;
+
+    utility::sharded_counter steals;
+    utility::sharded_counter completed;
+
+    counters_t():
+        pending(0)
+    {}
+};
+
+namespace {
+
+// Executor and index of the worker running on this thread, if any.
+thread_local const stealing_t* owner = nullptr;
+thread_local std::size_t current = 0;
+
+} // namespace
+
+stealing_t::stealing_t(std::size_t size, const cpuset_t& cpus_):
+    cpus(cpus_),
+    counters(std::make_shared<counters_t>()),
+    cursor(0),
+    sleeping(0),
+    stopping(false),
+    spawning(0)
+{
+    if(size == 0) {
+        throw cocaine::error_t("executor must have at least one thread");
+    }
+
+    for(std::size_t i = 0; i < size; ++i) {
+        workers.emplace_back(new worker_t);
+    }
+
+    try {
+        for(std::size_t i = 0; i < size; ++i) {
+            threads.emplace_back(&stealing_t::run, this, i);
+        }
+    } catch(...) {
+        stop();
+        throw;
+    }
+}
+
+stealing_t::~stealing_t() {
+    stop();
+}
+
+auto
+stealing_t::spawn(work_t work) -> void {
+    const bool inside = owner == this;
+
+    if(!inside) {
+        spawning.fetch_add(1);
+
+        if(stopping.load()) {
+            spawning.fetch_sub(1);
+            throw std::system_error(std::make_error_code(std::errc::operation_canceled),
+                "executor is stopped");
+        }
+    }
+
+    const auto index = inside ? current : cursor.fetch_add(1, std::memory_order_relaxed) % workers.size();
+
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->queue.push_back(std::move(work));
+    }
+
+    // NOTE: Workers count themselves as sleeping before checking for pending work under the lock, so
+    // either they see this work, or it sees them and wakes one up.
+    counters->pending.fetch_add(1);
+
+    if(!inside) {
+        spawning.fetch_sub(1);
+    }
+
+    if(sleeping.load() != 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.notify_one();
+    }
+}
+
+auto
+stealing_t::size() const -> std::size_t {
+    return workers.size();
+}
+
+auto
+stealing_t::publish(metrics::registry_t& hub, const std::string& prefix) -> void {
+    const auto counters = this->counters;
+
+    hub.register_gauge<std::int64_t>(cocaine::format("{}.queue", prefix), [=]() -> std::int64_t {
+        return counters->pending.load();
+    });
+
+    hub.register_gauge<std::int64_t>(cocaine::format("{}.steals", prefix), [=]() -> std::int64_t {
+        return counters->steals.load();
+    });
+
+    hub.register_gauge<std::int64_t>(cocaine::format("{}.completed", prefix), [=]() -> std::int64_t {
+        return counters->completed.load();
+    });
+}
+
+auto
+stealing_t::stop() -> void {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    idle.notify_all();
+
+    for(auto it = threads.begin(); it != threads.end(); ++it) {
+        if(it->joinable()) {
+            it->join();
+        }
+    }
+}
+
+auto
+stealing_t::run(std::size_t index) -> void {
+    // NOTE: Configured CPU sets are checked against the ones available to the process in advance.
+    cpus.apply();
+
+    owner = this;
+    current = index;
+
+    work_t work;
+
+    while(true) {
+        if(take(index, work)) {
+            work();
+            work = nullptr;
+
+            counters->completed.add(1);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        sleeping.fetch_add(1);
+
+        idle.wait(lock, [&] {
+            return counters->pending.load() != 0 || stopping;
+        });
+
+        sleeping.fetch_sub(1);
+
+        // NOTE: Spawning threads are checked first, as they only leave after the work is counted.
+        if(stopping && spawning.load() == 0 && counters->pending.load() == 0) {
+            break;
+        }
+    }
+
+    owner = nullptr;
+}
+
+auto
+stealing_t::take(std::size_t index, work_t& work) -> bool {
+    {
+        auto& worker = *workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+
+        if(!worker.queue.empty()) {
+            work = std::move(worker.queue.back());
+            worker.queue.pop_back();
+            counters->pending.fetch_sub(1);
+            return true;
+        }
+    }
+
+    for(std::size_t i = 1; i < workers.size(); ++i) {
+        auto& victim = *workers[(index + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if(!victim.queue.empty()) {
+            work = std::move(victim.queue.front());
+            victim.queue.pop_front();
+            counters->pending.fetch_sub(1);
+            counters->steals.add(1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+} // namespace executor
+} // namespace cocaine
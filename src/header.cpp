@@ -21,17 +21,22 @@
 #include "cocaine/hpack/header.hpp"
 #include "cocaine/hpack/static_table.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <sstream>
 
 namespace cocaine { namespace hpack {
 
 namespace header {
 
+namespace {
+
+template<class Headers>
 boost::optional<const header_t&>
-find_first(const std::vector<header_t>& headers, const char* name, size_t sz) {
+find_first_impl(const Headers& headers, const char* name, size_t sz) {
     auto it = std::find_if(headers.begin(), headers.end(), [&](const header_t& h){
-        return h.name().size() == sz && h.name() == name;
+        return h.name().size() == sz && std::memcmp(h.name().data(), name, sz) == 0;
     });
     if(it != headers.end()) {
         return boost::make_optional<const header_t&>(*it);
@@ -39,11 +44,28 @@ find_first(const std::vector<header_t>& headers, const char* name, size_t sz) {
     return boost::none;
 }
 
+} // namespace
+
+boost::optional<const header_t&>
+find_first(const std::vector<header_t>& headers, const char* name, size_t sz) {
+    return find_first_impl(headers, name, sz);
+}
+
 boost::optional<const header_t&>
 find_first(const std::vector<header_t>& headers, const std::string& name) {
     return find_first(headers, name.c_str(), name.size());
 }
 
+boost::optional<const header_t&>
+find_first(const headers_t& headers, const char* name, size_t sz) {
+    return find_first_impl(headers, name, sz);
+}
+
+boost::optional<const header_t&>
+find_first(const headers_t& headers, const std::string& name) {
+    return find_first(headers, name.c_str(), name.size());
+}
+
 }
 
 struct init_header_t {
@@ -67,35 +89,84 @@ init_data() {
     return data;
 }
 
+header_t::header_t() :
+    interned(nullptr),
+    borrowed(nullptr),
+    borrowed_size(0)
+{}
+
+header_t::header_t(std::string _name, std::string _value) :
+    interned(nullptr),
+    own_name(std::move(_name)),
+    own_value(std::move(_value)),
+    borrowed(nullptr),
+    borrowed_size(0)
+{}
+
+header_t::header_t(const header_t& other) :
+    interned(other.interned),
+    own_name(other.own_name),
+    own_value(other.value_data(), other.value_size()),
+    borrowed(nullptr),
+    borrowed_size(0)
+{}
+
+header_t&
+header_t::operator=(const header_t& other) {
+    if(this != &other) {
+        interned = other.interned;
+        own_name = other.own_name;
+        own_value.assign(other.value_data(), other.value_size());
+        borrowed = nullptr;
+        borrowed_size = 0;
+    }
+
+    return *this;
+}
+
 bool
 header_t::operator==(const header_t& other) const {
-    return data.name == other.data.name && data.value == other.data.value;
+    return name_equal(other) &&
+           value_size() == other.value_size() &&
+           std::memcmp(value_data(), other.value_data(), value_size()) == 0;
 }
 
 bool
 header_t::name_equal(const header_t& other) const {
-    return data.name == other.data.name;
+    return (interned && interned == other.interned) || name() == other.name();
 }
 
-header_t::header_t(std::string _name, std::string _value) :
-    data({std::move(_name),std::move(_value)})
-{}
-
 const std::string&
 header_t::name() const {
-    return data.name;
+    return interned ? *interned : own_name;
 }
 
 const std::string&
 header_t::value() const {
-    return data.value;
+    if(borrowed) {
+        own_value.assign(borrowed, borrowed_size);
+        borrowed = nullptr;
+        borrowed_size = 0;
+    }
+
+    return own_value;
+}
+
+const char*
+header_t::value_data() const {
+    return borrowed ? borrowed : own_value.data();
+}
+
+size_t
+header_t::value_size() const {
+    return borrowed ? borrowed_size : own_value.size();
 }
 
 size_t
 header_t::http2_size() const {
     // 1 refer to string literals which has size with 1-bit padding.
     // See https://tools.ietf.org/html/draft-ietf-httpbis-header-compression-12#section-5.2
-    return data.name.size() + data.value.size() + header_table_t::http2_header_overhead;
+    return name().size() + value_size() + header_table_t::http2_header_overhead;
 }
 
 const header_static_table_t::storage_t&
@@ -104,16 +175,333 @@ header_static_table_t::get_headers() {
     return storage;
 }
 
+namespace detail {
+
+constexpr size_t header_index_t::npos;
+
+header_index_t::header_index_t() {
+    slots.fill(slot_t{0, 0});
+}
+
+template<class Predicate>
+size_t
+header_index_t::find(size_t hash, Predicate predicate) const {
+    const uint32_t key = static_cast<uint32_t>(hash);
+
+    for(size_t i = key % capacity; slots[i].position; i = (i + 1) % capacity) {
+        if(slots[i].hash == key && predicate(slots[i].position - 1)) {
+            return slots[i].position - 1;
+        }
+    }
+
+    return npos;
+}
+
+template<class Predicate>
+void
+header_index_t::insert(size_t hash, size_t position, Predicate predicate) {
+    const uint32_t key = static_cast<uint32_t>(hash);
+
+    size_t i = key % capacity;
+
+    for(; slots[i].position; i = (i + 1) % capacity) {
+        if(slots[i].hash == key && predicate(slots[i].position - 1)) {
+            break;
+        }
+    }
+
+    slots[i] = slot_t{key, static_cast<uint32_t>(position + 1)};
+}
+
+void
+header_index_t::erase(size_t hash, size_t position) {
+    const uint32_t key = static_cast<uint32_t>(hash);
+
+    size_t i = key % capacity;
+
+    for(; slots[i].position; i = (i + 1) % capacity) {
+        if(slots[i].hash == key && slots[i].position == position + 1) {
+            break;
+        }
+    }
+
+    if(!slots[i].position) {
+        return;
+    }
+
+    // Backward shift deletion, so that lookups never need tombstones.
+    for(size_t j = (i + 1) % capacity; slots[j].position; j = (j + 1) % capacity) {
+        const size_t home = slots[j].hash % capacity;
+
+        // Move the slot into the hole unless its home lies cyclically in (i, j].
+        const bool movable = i <= j ? (home <= i || home > j) : (home <= i && home > j);
+
+        if(movable) {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+
+    slots[i] = slot_t{0, 0};
+}
+
+} // namespace detail
+
+namespace {
+
+// FNV-1a, good enough for short header names and values.
+size_t
+hash_bytes(const char* data, size_t size, size_t seed = 14695981039346656037ULL) {
+    uint64_t hash = seed;
+
+    for(size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+size_t
+hash_name(const header_t& header) {
+    return hash_bytes(header.name().data(), header.name().size());
+}
+
+size_t
+hash_full(const header_t& header) {
+    // NOTE: The separator makes ("ab", "c") and ("a", "bc") hash differently.
+    const size_t seed = hash_bytes("", 1, hash_name(header));
+    return hash_bytes(header.value_data(), header.value_size(), seed);
+}
+
+struct static_index_t {
+    detail::header_index_t by_full_match;
+    detail::header_index_t by_name;
+
+    static_index_t() {
+        const auto& headers = header_static_table_t::get_headers();
+
+        // Keep the lowest index for duplicate keys, as the static table is searched from the start.
+        for(size_t i = 0; i < headers.size(); ++i) {
+            const auto& header = headers[i];
+
+            if(by_full_match.find(hash_full(header), [&](size_t pos) { return headers[pos] == header; })
+                == detail::header_index_t::npos)
+            {
+                by_full_match.insert(hash_full(header), i, [](size_t) { return false; });
+            }
+
+            if(by_name.find(hash_name(header), [&](size_t pos) { return headers[pos].name_equal(header); })
+                == detail::header_index_t::npos)
+            {
+                by_name.insert(hash_name(header), i, [](size_t) { return false; });
+            }
+        }
+    }
+};
+
+const static_index_t&
+static_index() {
+    static const static_index_t index;
+    return index;
+}
+
+} // namespace
+
+header_t
+header_t::borrow(const char* name, size_t name_size, const char* value, size_t value_size) {
+    header_t result;
+
+    const auto& statics = header_static_table_t::get_headers();
+
+    const size_t pos = static_index().by_name.find(hash_bytes(name, name_size), [&](size_t i) {
+        return statics[i].name().size() == name_size &&
+               std::memcmp(statics[i].name().data(), name, name_size) == 0;
+    });
+
+    if(pos != detail::header_index_t::npos) {
+        result.interned = &statics[pos].name();
+    } else {
+        result.own_name.assign(name, name_size);
+    }
+
+    result.borrowed = value;
+    result.borrowed_size = value_size;
+
+    return result;
+}
+
+constexpr size_t headers_t::inline_capacity;
+
+headers_t::headers_t() :
+    ptr(reinterpret_cast<header_t*>(buffer)),
+    length(0),
+    allocated(inline_capacity)
+{}
+
+headers_t::headers_t(std::initializer_list<header_t> list) :
+    headers_t()
+{
+    reserve(list.size());
+
+    for(const auto& header: list) {
+        push_back(header);
+    }
+}
+
+headers_t::headers_t(const std::vector<header_t>& other) :
+    headers_t()
+{
+    reserve(other.size());
+
+    for(const auto& header: other) {
+        push_back(header);
+    }
+}
+
+headers_t::headers_t(const headers_t& other) :
+    headers_t()
+{
+    reserve(other.size());
+
+    for(const auto& header: other) {
+        push_back(header);
+    }
+}
+
+headers_t::headers_t(headers_t&& other) :
+    headers_t()
+{
+    *this = std::move(other);
+}
+
+headers_t::~headers_t() {
+    clear();
+
+    if(!is_inline()) {
+        ::operator delete(ptr);
+    }
+}
+
+headers_t&
+headers_t::operator=(const headers_t& other) {
+    if(this != &other) {
+        clear();
+        reserve(other.size());
+
+        for(const auto& header: other) {
+            push_back(header);
+        }
+    }
+
+    return *this;
+}
+
+headers_t&
+headers_t::operator=(headers_t&& other) {
+    if(this == &other) {
+        return *this;
+    }
+
+    clear();
+
+    if(!other.is_inline()) {
+        // Steal the heap storage.
+        if(!is_inline()) {
+            ::operator delete(ptr);
+        }
+
+        ptr = other.ptr;
+        length = other.length;
+        allocated = other.allocated;
+
+        other.ptr = reinterpret_cast<header_t*>(other.buffer);
+        other.length = 0;
+        other.allocated = inline_capacity;
+    } else {
+        reserve(other.size());
+
+        for(auto& header: other) {
+            push_back(std::move(header));
+        }
+
+        other.clear();
+    }
+
+    return *this;
+}
+
+headers_t::operator std::vector<header_t>() const {
+    return std::vector<header_t>(begin(), end());
+}
+
+void
+headers_t::reserve(size_t size) {
+    if(size <= allocated) {
+        return;
+    }
+
+    header_t* storage = static_cast<header_t*>(::operator new(size * sizeof(header_t)));
+
+    for(size_t i = 0; i < length; ++i) {
+        new(storage + i) header_t(std::move(ptr[i]));
+        ptr[i].~header_t();
+    }
+
+    if(!is_inline()) {
+        ::operator delete(ptr);
+    }
+
+    ptr = storage;
+    allocated = size;
+}
+
+void
+headers_t::pop_back() {
+    ptr[--length].~header_t();
+}
+
+headers_t::iterator
+headers_t::erase(const_iterator position) {
+    iterator it = begin() + (position - begin());
+
+    std::move(it + 1, end(), it);
+    pop_back();
+
+    return it;
+}
+
+void
+headers_t::clear() {
+    while(length) {
+        pop_back();
+    }
+}
+
+bool
+headers_t::is_inline() const {
+    return ptr == reinterpret_cast<const header_t*>(buffer);
+}
+
+bool
+operator==(const headers_t& lhs, const headers_t& rhs) {
+    return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+bool
+operator!=(const headers_t& lhs, const headers_t& rhs) {
+    return !(lhs == rhs);
+}
+
 header_table_t::header_table_t() :
+    tail(0),
+    count(0),
+    total(0),
     capacity(max_data_capacity)
 {}
 
 size_t
 header_table_t::data_size() const {
-    size_t total = 0;
-    for (const auto& h : headers) {
-        total += h.http2_size();
-    }
     return total;
 }
 
@@ -124,59 +512,138 @@ header_table_t::data_capacity() const {
 
 size_t
 header_table_t::size() const {
-    return header_static_table_t::size + headers.size();
+    return header_static_table_t::size + count;
 }
 
 bool
 header_table_t::empty() const {
-    return headers.empty();
+    return count == 0;
 }
 
 void
 header_table_t::push(header_t header) {
-    size_t header_size = header.http2_size();
+    const size_t header_size = header.http2_size();
 
     // Pop headers from table until there is enough room for new one or table is empty
-    auto sz = data_size();
-    while(sz + header_size > capacity && !empty()) {
-        sz -= headers.back().http2_size();
-        headers.pop_back();
+    while(total + header_size > capacity && !empty()) {
+        pop();
     }
 
     // Header does not fit in the table. According to RFC we just clean the table and do not put the header inside.
-    if(empty() && (data_size() + header_size > capacity)) {
+    if(header_size > capacity) {
         return;
     }
 
-    headers.push_front(std::move(header));
+    if(!dynamic) {
+        dynamic.reset(new dynamic_t());
+    }
+
+    const size_t position = (tail + count) % max_entries;
+
+    auto& ring = dynamic->ring;
+
+    ring[position] = std::move(header);
+
+    const auto& stored = ring[position];
+
+    // Table entries must own their values, as they outlive the frame the header came from.
+    stored.value();
+
+    // Newer entries shadow older ones with the same key, as lookups prefer lower indices.
+    dynamic->by_full_match.insert(hash_full(stored), position, [&](size_t pos) {
+        return ring[pos] == stored;
+    });
+
+    dynamic->by_name.insert(hash_name(stored), position, [&](size_t pos) {
+        return ring[pos].name_equal(stored);
+    });
+
+    total += header_size;
+    count += 1;
 }
 
-std::size_t
-header_table_t::find(const std::function<bool(const header_t&)> fn) {
+void
+header_table_t::pop() {
+    auto& oldest = dynamic->ring[tail];
+
+    // NOTE: Index slots only point to the newest entry for each key, and since this one is the
+    // oldest, the slot either points to it, meaning there are no other entries with this key, or
+    // to some newer entry, in which case it's left intact.
+    dynamic->by_full_match.erase(hash_full(oldest), tail);
+    dynamic->by_name.erase(hash_name(oldest), tail);
+
+    total -= oldest.http2_size();
+    oldest = header_t();
+
+    tail = (tail + 1) % max_entries;
+    count -= 1;
+}
+
+size_t
+header_table_t::index_of(size_t position) const {
+    const size_t newest = (tail + count - 1) % max_entries;
+    return header_static_table_t::size + (newest + max_entries - position) % max_entries;
+}
+
+size_t
+header_table_t::find_by_full_match(const header_t& header) {
     const auto& statics = header_static_table_t::get_headers();
+    const size_t hash = hash_full(header);
 
-    auto it = std::find_if(std::begin(statics), std::end(statics), fn);
+    size_t pos = static_index().by_full_match.find(hash, [&](size_t i) {
+        return statics[i] == header;
+    });
 
-    if(it != std::end(statics)) {
-        return std::distance(std::begin(statics), it);
+    if(pos != detail::header_index_t::npos) {
+        return pos;
     }
 
-    auto dynit = std::find_if(std::begin(headers), std::end(headers), fn);
-    if(dynit != std::end(headers)) {
-        return std::distance(headers.begin(), dynit) + header_static_table_t::size;
+    if(empty()) {
+        return 0;
     }
-    return 0;
+
+    pos = dynamic->by_full_match.find(hash, [&](size_t i) {
+        return dynamic->ring[i] == header;
+    });
+
+    return pos != detail::header_index_t::npos ? index_of(pos) : 0;
+}
+
+size_t
+header_table_t::find_by_name(const header_t& header) {
+    const auto& statics = header_static_table_t::get_headers();
+    const size_t hash = hash_name(header);
+
+    size_t pos = static_index().by_name.find(hash, [&](size_t i) {
+        return statics[i].name_equal(header);
+    });
+
+    if(pos != detail::header_index_t::npos) {
+        return pos;
+    }
+
+    if(empty()) {
+        return 0;
+    }
+
+    pos = dynamic->by_name.find(hash, [&](size_t i) {
+        return dynamic->ring[i].name_equal(header);
+    });
+
+    return pos != detail::header_index_t::npos ? index_of(pos) : 0;
 }
 
 const header_t&
 header_table_t::operator[](size_t idx) {
-    if(idx == 0 || idx > headers.size() + header_static_table_t::size) {
+    if(idx == 0 || idx >= size()) {
         throw std::out_of_range("invalid index for header table");
     }
     if(idx < header_static_table_t::size) {
         return header_static_table_t::get_headers()[idx];
     }
-    return headers[idx - header_static_table_t::size];
+
+    const size_t newest = (tail + count - 1) % max_entries;
+    return dynamic->ring[(newest + max_entries - (idx - header_static_table_t::size)) % max_entries];
 }
 
 }} // namespace cocaine::hpack
@@ -82,11 +82,16 @@ class locator_t::connect_sink_t: public dispatch<event_traits<locator::connect>:
     locator_t  *const parent;
     std::string const uuid;
 
+    // Flow control. The channel holds both the sink and the upstream, so the latter is weak.
+    std::weak_ptr<io::basic_upstream_t> downstream;
+    std::uint64_t consumed;
+
 public:
     connect_sink_t(locator_t *const parent_, const std::string& uuid_):
         dispatch<event_traits<locator::connect>::upstream_type>(parent_->name() + ":client"),
         parent(parent_),
-        uuid(uuid_)
+        uuid(uuid_),
+        consumed(0)
     {
         typedef io::protocol<event_traits<locator::connect>::upstream_type>::scope protocol;
 
@@ -103,7 +108,14 @@ public:
     void
     discard(const std::error_code& ec);
 
+    // Grants the remote locator the initial credit for the stream, if flow control is enabled.
+    void
+    attach(const io::upstream_ptr_t& ptr);
+
 private:
+    void
+    replenish();
+
     void
     on_announce(hpack::headers_t headers, const std::string& node, std::map<std::string, results::resolve>&& update);
 
@@ -122,10 +134,38 @@ locator_t::connect_sink_t::discard(const std::error_code& ec) {
     parent->drop_node(uuid);
 }
 
+void
+locator_t::connect_sink_t::attach(const io::upstream_ptr_t& ptr) {
+    downstream = ptr;
+
+    if(parent->m_cfg.window) {
+        ptr->grant(parent->m_cfg.window);
+    }
+}
+
+void
+locator_t::connect_sink_t::replenish() {
+    const auto window = parent->m_cfg.window;
+
+    // Credit is returned in halves of the window, so that the remote rarely runs out of it while
+    // the window updates are in flight.
+    if(window == 0 || ++consumed < std::max<std::uint64_t>(window / 2, 1)) {
+        return;
+    }
+
+    if(const auto ptr = downstream.lock()) {
+        ptr->grant(consumed);
+    }
+
+    consumed = 0;
+}
+
 void
 locator_t::connect_sink_t::on_announce(hpack::headers_t headers, const std::string& node,
                                        std::map<std::string, results::resolve>&& update)
 {
+    replenish();
+
     if(node != uuid) {
         COCAINE_LOG_ERROR(parent->m_log, "remote client id mismatch: '{}' vs. '{}'", uuid, node);
 
@@ -151,7 +191,7 @@ locator_t::connect_sink_t::on_announce(hpack::headers_t headers, const std::stri
             if(extra_data) {
                 msgpack::unpacked unpacked;
                 size_t offset = 0;
-                msgpack::unpack(&unpacked, extra_data->value().data(), extra_data->value().size(), &offset);
+                msgpack::unpack(&unpacked, extra_data->value_data(), extra_data->value_size(), &offset);
                 io::type_traits<std::map<std::string, dynamic_t>>::unpack(unpacked.get(), extra);
             }
             parent->m_gateway->consume(uuid, name, versions, location, protocol, extra);
@@ -207,7 +247,7 @@ public:
     }
 
     auto
-    operator()(const std::vector<hpack::header_t>&,
+    operator()(const hpack::headers_t&,
                tuple_type&& args,
                upstream_type&& upstream) -> boost::optional<result_type>
     {
@@ -285,7 +325,7 @@ public:
     }
 
     auto
-    operator()(const std::vector<hpack::header_t>&,
+    operator()(const hpack::headers_t&,
                tuple_type&& args,
                upstream_type&& upstream) -> boost::optional<result_type>
     {
@@ -315,7 +355,8 @@ private:
 
 locator_cfg_t::locator_cfg_t(const std::string& name_, const dynamic_t& root):
     name(name_),
-    extra_param(root.as_object().at("extra_param", dynamic_t::empty_object).as_object())
+    extra_param(root.as_object().at("extra_param", dynamic_t::empty_object).as_object()),
+    window(root.as_object().at("window", 0u).as_uint())
 {
     restricted = root.as_object().at("restrict", dynamic_t::array_t()).to<std::set<std::string>>();
     restricted.insert(name);
@@ -471,10 +512,12 @@ locator_t::link_node(const std::string& uuid, const std::vector<tcp::endpoint>&
         // Something went wrong in the session creation code above, bail out.
         if(!session) return;
 
-        auto upstream = session->fork(std::make_shared<connect_sink_t>(this, uuid));
+        auto sink = std::make_shared<connect_sink_t>(this, uuid);
+        auto upstream = session->fork(sink);
 
         try {
             upstream->send<locator::connect>(this->uuid());
+            sink->attach(upstream);
         } catch(const std::system_error& e) {
             COCAINE_LOG_ERROR(m_log, "unable to set up remote stream: {}", error::to_string(e));
             m_clients->erase(uuid);
@@ -597,6 +640,9 @@ locator_t::on_connect(const std::string& uuid) -> streamed<results::connect> {
         COCAINE_LOG_INFO(m_log, "attaching outgoing stream for locator");
     }
 
+    // Remote nodes might want to limit the number of updates in flight, see connect_sink_t.
+    stream.enable_flow_control();
+
     // Store the stream to synchronize future service updates with the remote node. Updates are
     // sent out on context service signals, and propagate to all nodes in the cluster.
     mapping->insert({uuid, stream});
@@ -169,7 +169,7 @@ storage_t::storage_t(context_t& context, asio::io_service& asio, const std::stri
         .execute([=](
             const std::string& collection,
             const std::string& key,
-            const std::string& blob,
+            const io::slice_t& blob,
             const std::vector<std::string>& tags,
             const auth::identity_t& identity,
             const std::shared_ptr<logging::logger_t>& log)
@@ -187,7 +187,9 @@ storage_t::storage_t(context_t& context, asio::io_service& asio, const std::stri
             }
 
             const auto size = blob.size();
-            backend->write(collection, key, blob, tags, [=](std::future<void> future) mutable {
+
+            // NOTE: This is the only copy of the blob on its way from the socket to the backend.
+            backend->write(collection, key, blob.to_string(), tags, [=](std::future<void> future) mutable {
                 try {
                     future.get();
                     COCAINE_LOG_INFO(log, "completed 'write' operation", {
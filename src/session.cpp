@@ -20,6 +20,9 @@
 
 #include "cocaine/rpc/session.hpp"
 
+#include <algorithm>
+#include <chrono>
+
 #include <asio/ip/tcp.hpp>
 #include <asio/local/stream_protocol.hpp>
 
@@ -27,18 +30,19 @@
 
 #include <blackhole/logger.hpp>
 
-#include <metrics/accumulator/decaying/exponentially.hpp>
-#include <metrics/accumulator/snapshot/weighted.hpp>
 #include <metrics/meter.hpp>
 #include <metrics/registry.hpp>
-#include <metrics/timer.hpp>
 
+#include "cocaine/defaults.hpp"
 #include "cocaine/hpack/static_table.hpp"
 #include "cocaine/logging.hpp"
 #include "cocaine/rpc/asio/transport.hpp"
 #include "cocaine/rpc/basic_dispatch.hpp"
 #include "cocaine/rpc/dispatch.hpp"
 #include "cocaine/rpc/upstream.hpp"
+#include "cocaine/traits/error_code.hpp"
+#include "cocaine/utility/histogram.hpp"
+#include "cocaine/utility/sharded_counter.hpp"
 
 using namespace cocaine;
 using namespace cocaine::io;
@@ -66,6 +70,9 @@ public:
 private:
     void
     finalize(const std::error_code& ec);
+
+    auto
+    transport() const -> std::shared_ptr<transport_type>;
 };
 
 void
@@ -88,19 +95,21 @@ session_t::pull_action_t::finalize(const std::error_code& ec) {
         return session->detach(ec);
     }
 
-#if defined(__clang__)
-    if(const auto ptr = std::atomic_load(&session->transport)) {
-#else
-    if(const auto ptr = *session->transport.synchronize()) {
-#endif
+    // NOTE: Pipelined messages are usually received all at once, so those which are already in the
+    // ring are handled right away instead of going through the reactor one by one. The budget caps
+    // the number of messages handled per turn, so that a single chatty client can't starve other
+    // sessions of the same execution unit.
+    std::size_t budget = session->budget;
+    std::error_code error;
+
+    while(const auto ptr = transport()) {
         try {
             // NOTE: In case the underlying slot has miserably failed to handle its exceptions, the
             // client will be disconnected to prevent any further damage to the service and himself.
 
             // TODO: it seems that we can move it into and process message everywhere by value
             // This can help to avoid unnecsesarry headers copy
-            session->handle(message);
-            message.clear();
+            error = session->handle(message);
         } catch(const std::system_error& e) {
             COCAINE_LOG_ERROR(session->log, "uncaught invocation exception: {}", error::to_string(e));
             return session->detach(e.code());
@@ -109,90 +118,222 @@ session_t::pull_action_t::finalize(const std::error_code& ec) {
             return session->detach(error::uncaught_error);
         }
 
-        // Cycle the transport back into the message pump.
-        operator()(std::move(ptr));
-    } else {
-        COCAINE_LOG_DEBUG(session->log, "ignoring invocation due to detached session");
-    }
-}
-
-class session_t::push_action_t:
-    public enable_shared_from_this<push_action_t>
-{
-    const encoder_t::message_type message;
-
-    // Keeps the session alive until all the operations are complete.
-    const std::shared_ptr<session_t> session;
+        if(error) {
+            // Misbehaving clients are disconnected as well, but without paying for an exception.
+            COCAINE_LOG_ERROR(session->log, "rejected invocation type {:d} in channel {:d}: [{:d}] {}",
+                message.type(), message.span(), error.value(), error.message());
+            return session->detach(error);
+        }
 
-public:
-    push_action_t(encoder_t::message_type&& message, const std::shared_ptr<session_t>& session_):
-        message(std::move(message)),
-        session(session_)
-    { }
+        message.clear();
 
-    void
-    operator()(const std::shared_ptr<transport_type> ptr);
+        if(session->saturated()) {
+            // Stop reading until the client consumes the responses, the session will resume the pump
+            // once it's drained. Otherwise pipelined requests would pile up responses indefinitely.
+            if(session->pause(shared_from_this())) {
+                COCAINE_LOG_DEBUG(session->log, "pausing the message pump due to backlog");
+                return;
+            }
+        }
 
-private:
-    void
-    finalize(const std::error_code& ec);
-};
+        if(--budget == 0 || !ptr->reader->read_buffered(message, error)) {
+            // Cycle the transport back into the message pump. If the budget is exhausted, the next
+            // buffered message will be handled in the next turn, since completions are posted.
+            return operator()(std::move(ptr));
+        }
 
-void
-session_t::push_action_t::operator()(const std::shared_ptr<transport_type> ptr) {
-    if(!trace_t::current().empty()) {
-        if(trace_t::current().pushed()) {
-            COCAINE_LOG_DEBUG(session->log, "cs");
-        } else {
-            COCAINE_LOG_DEBUG(session->log, "ss");
+        if(error) {
+            return finalize(error);
         }
     }
 
-    ptr->writer->write(message, trace_t::bind(&push_action_t::finalize,
-        shared_from_this(),
-        std::placeholders::_1
-    ));
+    COCAINE_LOG_DEBUG(session->log, "ignoring invocation due to detached session");
 }
 
-void
-session_t::push_action_t::finalize(const std::error_code& ec) {
-    COCAINE_LOG_DEBUG(session->log, "after send");
-    if(ec.value() == 0) return;
+auto
+session_t::pull_action_t::transport() const -> std::shared_ptr<transport_type> {
+#if defined(__clang__)
+    return std::atomic_load(&session->transport);
+#else
+    return *session->transport.synchronize();
+#endif
+}
 
-    if(ec != asio::error::eof) {
-        COCAINE_LOG_ERROR(session->log, "client disconnected: [{:d}] {}", ec.value(), ec.message());
-    } else {
-        COCAINE_LOG_DEBUG(session->log, "client disconnected");
-    }
+// An outgoing message along with the trace it was sent in.
 
-    return session->detach(ec);
-}
+struct session_t::outgoing_t {
+    encoder_t::message_type message;
+    trace_t trace;
+};
+
+// Tracks the number of requests in progress and their latency, which is the time from the first
+// message in the channel until both the client and the service are done with it.
 
 class load_watcher_t {
-    metrics::shared_metric<std::atomic<std::int64_t>> load;
+    utility::sharded_counter& load;
+    utility::windowed_histogram* const timer;
+
+    const std::chrono::steady_clock::time_point birth;
 
 public:
-    load_watcher_t(metrics::shared_metric<std::atomic<std::int64_t>> load) :
-        load(std::move(load))
+    load_watcher_t(utility::sharded_counter& load_, utility::windowed_histogram* timer_) :
+        load(load_),
+        timer(timer_),
+        birth(std::chrono::steady_clock::now())
     {
-        this->load->fetch_add(1);
+        load.add(1);
     }
 
     ~load_watcher_t() {
-        this->load->fetch_add(-1);
+        load.add(-1);
+
+        if(timer) {
+            timer->record(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - birth
+            ).count());
+        }
     }
 };
 
+// The upstream of a channel carries the load and timing metrics, so that they last until the service
+// is done with the upstream.
+
+struct metered_upstream_t:
+    public basic_upstream_t
+{
+    metered_upstream_t(const std::shared_ptr<session_t>& session, uint64_t channel_id):
+        basic_upstream_t(session, channel_id)
+    { }
+
+    boost::optional<load_watcher_t> load;
+};
+
+// NOTE: The upstream is a separate object, because dispatches often keep their upstreams, and it must
+// not keep the channel alive, including the dispatch itself.
+
 struct session_t::channel_t {
+    channel_t(std::shared_ptr<metered_upstream_t> upstream_, dispatch_ptr_t dispatch_,
+              boost::optional<trace_t> trace_):
+        dispatch(std::move(dispatch_)),
+        upstream(std::move(upstream_)),
+        trace(std::move(trace_))
+    { }
+
     dispatch_ptr_t dispatch;
-    upstream_ptr_t upstream;
-    std::shared_ptr<load_watcher_t> load;
-    std::shared_ptr<metrics::timer_t::context_t> context;
-    boost::optional<trace_t> trace;
+
+    // Immutable once the channel is created.
+    const std::shared_ptr<metered_upstream_t> upstream;
+    const boost::optional<trace_t> trace;
+};
+
+// Recycles the memory of closed channels. Objects are allocated along with their reference counts,
+// and every pool is used for objects of a single type, so all the blocks requested from a pool are of
+// the same size.
+
+class session_t::channel_pool_t {
+    COCAINE_DECLARE_NONCOPYABLE(channel_pool_t)
+
+    // The maximum number of idle blocks kept for reuse.
+    static const std::size_t kMaxIdle = 64;
+
+    struct idle_t {
+        idle_t(): size(0) { }
+
+        std::size_t size;
+        std::vector<void*> blocks;
+    };
+
+    synchronized<idle_t> idle;
+
+public:
+    channel_pool_t() = default;
+
+   ~channel_pool_t() {
+        auto ptr = idle.synchronize();
+
+        for(auto it = ptr->blocks.begin(); it != ptr->blocks.end(); ++it) {
+            ::operator delete(*it);
+        }
+    }
+
+    void*
+    allocate(std::size_t size) {
+        {
+            auto ptr = idle.synchronize();
+
+            if(ptr->size == size && !ptr->blocks.empty()) {
+                void* block = ptr->blocks.back();
+                ptr->blocks.pop_back();
+                return block;
+            }
+        }
+
+        return ::operator new(size);
+    }
+
+    void
+    deallocate(void* block, std::size_t size) {
+        {
+            auto ptr = idle.synchronize();
+
+            if(ptr->size == 0) {
+                ptr->size = size;
+                ptr->blocks.reserve(kMaxIdle);
+            }
+
+            if(ptr->size == size && ptr->blocks.size() < kMaxIdle) {
+                ptr->blocks.push_back(block);
+                return;
+            }
+        }
+
+        ::operator delete(block);
+    }
 };
 
 namespace {
 
+// The allocator keeps the pool alive, as channels might outlive the session which created them.
+
+template<class T, class Pool>
+struct pool_allocator {
+    typedef T value_type;
+
+    explicit
+    pool_allocator(std::shared_ptr<Pool> pool_):
+        pool(std::move(pool_))
+    { }
+
+    template<class U>
+    pool_allocator(const pool_allocator<U, Pool>& other):
+        pool(other.pool)
+    { }
+
+    T*
+    allocate(std::size_t n) {
+        return static_cast<T*>(pool->allocate(n * sizeof(T)));
+    }
+
+    void
+    deallocate(T* ptr, std::size_t n) {
+        pool->deallocate(ptr, n * sizeof(T));
+    }
+
+    std::shared_ptr<Pool> pool;
+};
+
+template<class T, class U, class Pool>
+bool
+operator==(const pool_allocator<T, Pool>& lhs, const pool_allocator<U, Pool>& rhs) {
+    return lhs.pool == rhs.pool;
+}
+
+template<class T, class U, class Pool>
+bool
+operator!=(const pool_allocator<T, Pool>& lhs, const pool_allocator<U, Pool>& rhs) {
+    return lhs.pool != rhs.pool;
+}
+
 auto
 dispatch_name(const dispatch_ptr_t& dispatch) -> std::string {
     if (dispatch) {
@@ -204,146 +345,369 @@ dispatch_name(const dispatch_ptr_t& dispatch) -> std::string {
 
 } // namespace
 
-// Session
+// Control events are handled the same way by all the sessions, so there is a single stateless
+// dispatch for them and the session is taken from the upstream of the channel instead.
 
-struct session_t::metrics_t {
-    using meter_type = metrics::shared_metric<metrics::meter_t>;
-    using timer_type = metrics::shared_metric<metrics::timer<metrics::accumulator::decaying::exponentially_t>>;
+class session_t::control_dispatch_t:
+    public io::basic_dispatch_t
+{
+public:
+    control_dispatch_t():
+        basic_dispatch_t("session")
+    { }
 
-    /// RPS counter.
-    meter_type summary;
+    static
+    auto
+    instance() -> const io::dispatch_ptr_t& {
+        static const io::dispatch_ptr_t dispatch = std::make_shared<control_dispatch_t>();
+        return dispatch;
+    }
 
-    /// Load gauge.
-    metrics::shared_metric<std::atomic<std::int64_t>> load;
+    virtual
+    boost::optional<io::dispatch_ptr_t>
+    process(const decoder_t::message_type& message, const upstream_ptr_t& upstream) {
+        std::error_code ec;
 
-    /// Timers per slot.
-    std::map<
-        int,
-        timer_type
-    > timers;
+        const auto result = try_process(message, upstream, ec);
 
-    metrics_t(metrics::registry_t& metrics_hub, session_t& session) :
-        summary(metrics_hub.meter(cocaine::format("{}.meter.summary", session.name()))),
-        load{
-            metrics_hub.counter<std::int64_t>(cocaine::format("{}.load", session.name())),
+        if(ec) {
+            throw rejection(message.type(), ec);
         }
+
+        return result;
+    }
+
+    virtual
+    boost::optional<io::dispatch_ptr_t>
+    try_process(const decoder_t::message_type& message, const upstream_ptr_t& upstream,
+                std::error_code& ec)
     {
-        for (auto& item : session.prototype->root()) {
-            auto id = std::get<0>(item);
-            auto& name = std::get<0>(std::get<1>(item));
+        const auto session = upstream->session();
+
+        switch(message.type()) {
+        case event_traits<control::ping>::id:
+            break;
+        case event_traits<control::revoke>::id: {
+            typename event_traits<control::revoke>::tuple_type args;
+
+            if((ec = unpack<control::revoke>(message, args))) {
+                return boost::none;
+            }
 
-            auto metric_name = cocaine::format("{}.timer[{}]", session.prototype->name(), name);
-            timers.emplace(
-                id,
-                metrics_hub.timer<metrics::accumulator::decaying::exponentially_t>(metric_name)
-            );
+            session->revoke(std::get<0>(args), std::get<1>(args));
+        } break;
+        case event_traits<control::window_update>::id: {
+            typename event_traits<control::window_update>::tuple_type args;
+
+            if((ec = unpack<control::window_update>(message, args))) {
+                return boost::none;
+            }
+
+            session->update_window(std::get<0>(args), std::get<1>(args));
+        } break;
+        default:
+            ec = error::slot_not_found;
+            return boost::none;
         }
+
+        // All the control events are terminal.
+        return boost::make_optional<io::dispatch_ptr_t>(nullptr);
+    }
+
+    virtual
+    auto
+    root() const -> const graph_root_t& {
+        static const graph_root_t graph = traverse<control_tag>().get();
+        return graph;
+    }
+
+    virtual
+    int
+    version() const {
+        return protocol<control_tag>::version::value;
     }
 
+private:
+    template<class Event>
+    static
+    std::error_code
+    unpack(const decoder_t::message_type& message, typename event_traits<Event>::tuple_type& args) {
+        return flat_unpacker<typename event_traits<Event>::argument_type>::unpack(message.args(), args);
+    }
+};
+
+// Channels opened over the limit are refused, but the client might have sent more messages into them
+// before learning about it. These are discarded, following the protocol graph of the service until
+// the client reaches a terminal message, so that the channel is closed the same way as usual.
+
+class session_t::refused_dispatch_t:
+    public io::basic_dispatch_t
+{
+    const graph_node_t graph;
+
+public:
+    refused_dispatch_t(const std::string& name, graph_node_t graph_):
+        basic_dispatch_t(name),
+        graph(std::move(graph_))
+    { }
+
+    // Starts with the root of the service protocol.
+    static
     auto
-    timer(int id) const -> boost::optional<timer_type> {
-        auto it = timers.find(id);
-        if (it == std::end(timers)) {
+    create(const io::basic_dispatch_t& prototype) -> io::dispatch_ptr_t {
+        graph_node_t graph;
+
+        for(const auto& item : prototype.root()) {
+            graph[item.first] = std::make_tuple(std::get<0>(item.second), std::get<1>(item.second));
+        }
+
+        return std::make_shared<refused_dispatch_t>(prototype.name(), std::move(graph));
+    }
+
+    virtual
+    boost::optional<io::dispatch_ptr_t>
+    process(const decoder_t::message_type& message, const upstream_ptr_t& upstream) {
+        std::error_code ec;
+        return try_process(message, upstream, ec);
+    }
+
+    virtual
+    boost::optional<io::dispatch_ptr_t>
+    try_process(const decoder_t::message_type& message, const upstream_ptr_t&, std::error_code&) {
+        const auto it = graph.find(message.type());
+
+        if(it == graph.end()) {
+            // Nothing can follow an unknown message, so the channel is closed right away.
+            return boost::make_optional<io::dispatch_ptr_t>(nullptr);
+        }
+
+        const auto& transition = std::get<1>(it->second);
+
+        if(!transition) {
             return boost::none;
         }
 
-        return it->second;
+        if(transition->empty()) {
+            return boost::make_optional<io::dispatch_ptr_t>(nullptr);
+        }
+
+        return boost::make_optional<io::dispatch_ptr_t>(std::make_shared<refused_dispatch_t>(name(),
+            *transition));
+    }
+
+    virtual
+    auto
+    root() const -> const graph_root_t& {
+        static const graph_root_t graph;
+        return graph;
+    }
+
+    virtual
+    int
+    version() const {
+        return 0;
     }
 };
 
-struct metered_upstream_t : public basic_upstream_t {
-    std::shared_ptr<load_watcher_t> load;
-    std::shared_ptr<metrics::timer_t::context_t> timer;
+// Session
+
+// Metrics are shared by all the sessions of a service and are never updated under a lock. The load
+// counter is sharded per thread and timers are lock-free histograms in a flat array indexed by event
+// id. Both are published as gauges, which are aggregated only when read. Timers only account for the
+// recent requests, so that their percentiles follow the latency changes instead of settling down.
+
+struct session_t::metrics_t {
+    /// Rate of requests handled.
+    metrics::shared_metric<metrics::meter_t> summary;
+
+    /// Number of requests in progress.
+    utility::sharded_counter load;
 
-    metered_upstream_t(const std::shared_ptr<session_t>& session,
-                       uint64_t channel_id,
-                       std::shared_ptr<load_watcher_t> load,
-                       std::shared_ptr<metrics::timer_t::context_t> timer)
-        : basic_upstream_t(session, channel_id), load(std::move(load)), timer(std::move(timer)) {}
+    /// Latency histograms in microseconds per slot, indexed by event id. Control events have none.
+    std::vector<std::unique_ptr<utility::windowed_histogram>> timers;
+
+    metrics_t(metrics::registry_t& hub, const io::basic_dispatch_t& prototype):
+        summary(hub.meter(cocaine::format("{}.meter.summary", prototype.name())))
+    {
+        // Service events are enumerated from zero, while control events are placed at the far end of
+        // the id space, so the latter are easy to skip.
+        for(const auto& item : prototype.root()) {
+            if(static_cast<std::size_t>(std::get<0>(item)) != timers.size()) {
+                break;
+            }
+
+            timers.emplace_back(new utility::windowed_histogram);
+        }
+    }
+
+    auto
+    timer(int id) const -> utility::windowed_histogram* {
+        return static_cast<std::size_t>(id) < timers.size() ? timers[id].get() : nullptr;
+    }
+
+    // Returns the metrics of the service, registering them in the hub on the first call.
+    static
+    auto
+    get(metrics::registry_t& hub, const io::basic_dispatch_t& prototype) -> std::shared_ptr<metrics_t>;
 };
 
+auto
+session_t::metrics_t::get(metrics::registry_t& hub, const io::basic_dispatch_t& prototype)
+    -> std::shared_ptr<metrics_t>
+{
+    typedef std::map<std::pair<const metrics::registry_t*, std::string>, std::weak_ptr<metrics_t>> cache_t;
+
+    // NOTE: The hub keeps the metrics alive via the gauges, so the cache holds weak references only.
+    static synchronized<cache_t> cache;
+
+    const auto name = prototype.name();
+
+    return cache.apply([&](cache_t& mapping) -> std::shared_ptr<metrics_t> {
+        auto& weak = mapping[std::make_pair(&hub, name)];
+
+        if(const auto ptr = weak.lock()) {
+            return ptr;
+        }
+
+        const auto ptr = std::make_shared<metrics_t>(hub, prototype);
+
+        hub.register_gauge<std::int64_t>(cocaine::format("{}.load", name), [=]() -> std::int64_t {
+            return ptr->load.load();
+        });
+
+        for(const auto& item : prototype.root()) {
+            const auto id = std::get<0>(item);
+
+            if(ptr->timer(id) == nullptr) {
+                continue;
+            }
+
+            const auto metric_name = cocaine::format("{}.timer[{}]", name, std::get<0>(std::get<1>(item)));
+
+            hub.register_gauge<std::uint64_t>(metric_name + ".count", [=]() -> std::uint64_t {
+                return ptr->timers[id]->count();
+            });
+
+            for(double q : {0.5, 0.75, 0.95, 0.98, 0.99}) {
+                const auto percentile = cocaine::format("{}.p{}", metric_name, static_cast<int>(q * 100));
+
+                hub.register_gauge<std::uint64_t>(percentile, [=]() -> std::uint64_t {
+                    return ptr->timers[id]->quantile(q);
+                });
+            }
+        }
+
+        weak = ptr;
+
+        return ptr;
+    });
+}
+
 session_t::session_t(std::unique_ptr<logging::logger_t> log_,
                      metrics::registry_t& metrics_hub,
                      std::unique_ptr<transport_type> transport_,
                      const dispatch_ptr_t& prototype_)
     : log(std::move(log_)),
+      reactor(transport_->socket->get_io_service()),
       transport(std::shared_ptr<transport_type>(std::move(transport_))),
+      detached(false),
       prototype(prototype_),
-      max_channel_id(0)
+      pool(std::make_shared<channel_pool_t>()),
+      upstream_pool(std::make_shared<channel_pool_t>()),
+      max_channel_id(0),
+      budget(defaults::pull_budget),
+      batch(defaults::flush_batch),
+      flushing(false),
+      write_limit(0),
+      congested(false),
+      max_channels(0)
 {
     if (prototype) {
-        metrics = std::make_unique<metrics_t>(metrics_hub, *this);
+        metrics = metrics_t::get(metrics_hub, *prototype);
     }
-
-    auto dispatch = std::make_shared<cocaine::dispatch<io::control_tag>>("session");
-
-    dispatch->on<io::control::ping>([&] {
-        return;
-    });
-    dispatch->on<io::control::revoke>([&](std::uint64_t id, std::error_code ec) {
-        revoke(id, ec);
-    });
-
-    service_dispatch = std::move(dispatch);
 }
 
 session_t::~session_t() = default;
 
 // Operations
 
-void
+std::error_code
 session_t::handle(const decoder_t::message_type& message) {
     const channel_map_t::key_type channel_id = message.span();
-    boost::optional<trace_t> trace;
+
+    std::error_code ec;
+    bool refused = false;
 
     const auto channel = channels.apply([&](channel_map_t& mapping) -> std::shared_ptr<channel_t> {
-        channel_map_t::const_iterator lb, ub;
+        if(const auto ptr = mapping.find(channel_id)) {
+            // NOTE: The virtual channel pointer is copied here to avoid data races.
+            return *ptr;
+        }
 
-        std::tie(lb, ub) = mapping.equal_range(channel_id);
+        if(channel_id <= max_channel_id) {
+            // NOTE: Checking whether channel number is always higher than the previous channel
+            // number is similar to an infinite TIME_WAIT timeout for TCP sockets. It might be not
+            // the best approach, but since we have 2^64 possible channels it's good enough.
+            ec = error::revoked_channel;
+            return nullptr;
+        }
 
-        if(lb == ub) {
-            if(channel_id <= max_channel_id) {
-                // NOTE: Checking whether channel number is always higher than the previous channel
-                // number is similar to an infinite TIME_WAIT timeout for TCP sockets. It might be
-                // not the best approach, but since we have 2^64 possible channels it's good enough.
-                throw std::system_error(error::revoked_channel, std::to_string(channel_id));
+        auto dispatch = select_dispatch(message);
+
+        // NOTE: Control events are terminal and never count towards the limit. Refused channels still
+        // occupy the mapping until the client closes them, so clients which keep opening channels
+        // regardless of the refusals are disconnected.
+        if(max_channels && mapping.size() >= max_channels && dispatch != control_dispatch_t::instance()) {
+            if(mapping.size() >= max_channels * 2) {
+                ec = error::refused_channel;
+                return nullptr;
             }
 
-            trace = extract_trace(message);
-
-            auto timer = std::make_shared<metrics::timer_t::context_t>(metrics->timers.at(message.type())->context());
-            auto watcher = std::make_shared<load_watcher_t>(metrics->load);
-
-            std::tie(lb, std::ignore) = mapping.insert({channel_id, std::make_shared<channel_t>(
-                channel_t{
-                    select_dispatch(message),
-                    std::make_shared<metered_upstream_t>(
-                        shared_from_this(),
-                        channel_id,
-                        watcher,
-                        timer
-                    ),
-                    watcher,
-                    timer,
-                    trace
-                }
-            )});
-            metrics->summary->mark();
+            dispatch = refused_dispatch_t::create(*prototype);
+            refused = true;
+        }
 
-            max_channel_id = channel_id;
-        } else {
-            trace = lb->second->trace;
+        auto upstream = std::allocate_shared<metered_upstream_t>(
+            pool_allocator<metered_upstream_t, channel_pool_t>(upstream_pool),
+            shared_from_this(),
+            channel_id
+        );
+
+        auto channel = std::allocate_shared<channel_t>(
+            pool_allocator<channel_t, channel_pool_t>(pool),
+            upstream,
+            dispatch,
+            extract_trace(message)
+        );
+
+        mapping.insert(channel_id, channel);
+
+        // NOTE: Control events, like window updates, are not requests, so they are not accounted.
+        if(channel->dispatch != control_dispatch_t::instance() && !refused) {
+            upstream->load.emplace(metrics->load, metrics->timer(message.type()));
+            metrics->summary->mark();
         }
 
-        // NOTE: The virtual channel pointer is copied here to avoid data races.
-        return lb->second;
+        max_channel_id = channel_id;
+
+        return channel;
     });
 
+    if(ec) {
+        return ec;
+    }
+
+    if(refused) {
+        COCAINE_LOG_DEBUG(log, "refusing channel {:d} over the limit of {:d} channels", channel_id,
+            max_channels);
+        refuse(channel_id);
+    }
+
     if(!channel->dispatch) {
-        throw std::system_error(error::unbound_dispatch);
+        return error::unbound_dispatch;
     }
 
-    trace_t::restore_scope_t trace_scope(trace);
+    trace_t::restore_scope_t trace_scope(channel->trace);
 
     COCAINE_LOG_DEBUG(log, "invocation type {}: '{}' in channel {}, dispatch: '{}'",
         message.type(),
@@ -362,16 +726,20 @@ session_t::handle(const decoder_t::message_type& message) {
         }
     }
 
-    if((channel->dispatch = channel->dispatch->process(message, channel->upstream)
-        .get_value_or(channel->dispatch)) == nullptr)
-    {
+    const auto dispatch = channel->dispatch->try_process(message, channel->upstream, ec);
+
+    if(ec) {
+        return ec;
+    }
+
+    if((channel->dispatch = dispatch.get_value_or(channel->dispatch)) == nullptr) {
         // NOTE: If the client has sent us the last message according to our dispatch graph, revoke
         // the channel. No-op if the channel is no longer in the mapping, e.g., was discarded during
         // session::detach(), which was called during the dispatch::process().
-        if(!channel.unique()) {
-            revoke(channel_id);
-        }
+        revoke(channel_id);
     }
+
+    return std::error_code();
 }
 
 auto
@@ -388,9 +756,9 @@ session_t::extract_trace(const io::decoder_t::message_type& message) const -> bo
         }
 
         return trace_t(
-            hpack::header::unpack<std::uint64_t>(trace->value()),
-            hpack::header::unpack<std::uint64_t>(span->value()),
-            hpack::header::unpack<std::uint64_t>(parent->value()),
+            hpack::header::unpack<std::uint64_t>(*trace),
+            hpack::header::unpack<std::uint64_t>(*span),
+            hpack::header::unpack<std::uint64_t>(*parent),
             verbose,
             std::get<0>(prototype->root().at(message.type()))
         );
@@ -405,34 +773,47 @@ session_t::select_dispatch(const io::decoder_t::message_type& message) const ->
     if(message.type() < prototype->root().size()) {
         return prototype;
     } else {
-        return service_dispatch;
+        return control_dispatch_t::instance();
     }
 }
 
 void
 session_t::revoke(uint64_t id) {
-    revoke(id, std::error_code());
+    const auto revoked = channels.apply([&](channel_map_t& mapping) {
+        return mapping.erase(id);
+    });
+
+    if(!revoked) {
+        return;
+    }
+
+    COCAINE_LOG_DEBUG(log, "revoking channel {:d}", id);
 }
 
 void
 session_t::revoke(uint64_t id, std::error_code ec) {
     channels.apply([&](channel_map_t& mapping) {
-        auto it = mapping.find(id);
+        const auto ptr = mapping.find(id);
 
-        if(it == mapping.end()) {
+        if(ptr == nullptr) {
             COCAINE_LOG_WARNING(log, "ignoring revoke request for channel {:d}", id);
             return;
         }
 
-        if(it->second->dispatch) {
+        if((*ptr)->dispatch) {
             COCAINE_LOG_ERROR(log, "revoking channel {:d}, dispatch: '{}'", id,
-                it->second->dispatch->name());
-            it->second->dispatch->discard(ec);
+                (*ptr)->dispatch->name());
+            (*ptr)->dispatch->discard(ec);
         } else {
             COCAINE_LOG_DEBUG(log, "revoking channel {:d}", id);
         }
 
-        mapping.erase(it);
+        mapping.erase(id);
+    });
+
+    // The remote peer has abandoned the channel, so it won't grant any more credit for it either.
+    windows.apply([&](window_map_t& mapping) {
+        mapping.erase(id);
     });
 }
 
@@ -440,32 +821,214 @@ upstream_ptr_t
 session_t::fork(const dispatch_ptr_t& dispatch) {
     return channels.apply([&](channel_map_t& mapping) -> upstream_ptr_t {
         const auto channel_id = ++max_channel_id;
+
+        COCAINE_LOG_DEBUG(log, "forking new channel {:d}, dispatch: '{}'", channel_id, dispatch_name(dispatch));
+
+        if(!dispatch) {
+            return std::make_shared<basic_upstream_t>(shared_from_this(), channel_id);
+        }
+
         auto trace = trace_t::current();
         trace.push(dispatch_name(dispatch));
-        const auto downstream = std::make_shared<basic_upstream_t>(shared_from_this(), channel_id);
 
-        COCAINE_LOG_DEBUG(log, "forking new channel {:d}, dispatch: '{}'", channel_id, dispatch_name(dispatch));
+        // NOTE: For mute slots, creating a new channel will essentially leak memory, since no
+        // response will ever be sent back, therefore the channel will never be revoked at all.
+        auto upstream = std::allocate_shared<metered_upstream_t>(
+            pool_allocator<metered_upstream_t, channel_pool_t>(upstream_pool),
+            shared_from_this(),
+            channel_id
+        );
 
-        if(dispatch) {
-            // NOTE: For mute slots, creating a new channel will essentially leak memory, since no
-            // response will ever be sent back, therefore the channel will never be revoked at all.
-            mapping.insert({channel_id, std::make_shared<channel_t>(
-                channel_t{
-                    dispatch,
-                    downstream,
-                    nullptr,
-                    nullptr,
-                    trace
-                }
-            )});
-        }
-
-        return downstream;
+        mapping.insert(channel_id, std::allocate_shared<channel_t>(
+            pool_allocator<channel_t, channel_pool_t>(pool),
+            upstream,
+            dispatch,
+            std::move(trace)
+        ));
+
+        return upstream;
     });
 }
 
+void
+session_t::on_window_update(uint64_t id, std::function<void(std::uint64_t)> handler) {
+    windows.apply([&](window_map_t& mapping) {
+        if(handler) {
+            mapping[id] = std::move(handler);
+        } else {
+            mapping.erase(id);
+        }
+    });
+}
+
+void
+session_t::grant(uint64_t id, std::uint64_t increment) {
+    // Control events are sent in their own channels, as the stream channel itself might already be
+    // closed from this side.
+    const auto channel_id = channels.apply([&](channel_map_t&) -> uint64_t {
+        return ++max_channel_id;
+    });
+
+    push(encoded<io::control::window_update>(channel_id, id, increment));
+}
+
+void
+session_t::refuse(uint64_t id) {
+    // Sent in its own channel, just like window updates.
+    const auto channel_id = channels.apply([&](channel_map_t&) -> uint64_t {
+        return ++max_channel_id;
+    });
+
+    push(encoded<io::control::revoke>(channel_id, id, std::error_code(error::refused_channel)));
+}
+
+void
+session_t::update_window(uint64_t id, std::uint64_t increment) {
+    const auto handler = windows.apply([&](const window_map_t& mapping) -> std::function<void(std::uint64_t)> {
+        auto it = mapping.find(id);
+        return it != mapping.end() ? it->second : nullptr;
+    });
+
+    if(!handler) {
+        COCAINE_LOG_DEBUG(log, "ignoring window update for channel {:d}", id);
+        return;
+    }
+
+    // NOTE: Handlers are invoked without the lock held, so that they could unregister themselves.
+    handler(increment);
+}
+
 // Channel I/O
 
+void
+session_t::set_budget(std::size_t budget_) {
+    budget = std::max<std::size_t>(budget_, 1);
+}
+
+void
+session_t::set_batch(std::size_t batch_) {
+    batch = std::max<std::size_t>(batch_, 1);
+}
+
+void
+session_t::set_coalescing(std::size_t bytes, boost::posix_time::time_duration latency) {
+#if defined(__clang__)
+    if(const auto ptr = std::atomic_load(&transport)) {
+#else
+    if(const auto ptr = *transport.synchronize()) {
+#endif
+        ptr->writer->set_coalescing(bytes, latency);
+    }
+}
+
+void
+session_t::set_watermarks(std::size_t low, std::size_t high, std::size_t limit) {
+    write_limit = limit;
+
+#if defined(__clang__)
+    if(const auto ptr = std::atomic_load(&transport)) {
+#else
+    if(const auto ptr = *transport.synchronize()) {
+#endif
+        // NOTE: The writer might outlive the session, as pending operations keep it alive.
+        const std::weak_ptr<session_t> weak = shared_from_this();
+
+        ptr->writer->set_watermarks(low, high, [weak](bool value) {
+            if(const auto self = weak.lock()) {
+                self->congest(value);
+            }
+        });
+    }
+}
+
+void
+session_t::on_writable(std::function<void()> callback) {
+    const bool ready = waiters.apply([&](std::vector<std::function<void()>>& queue) {
+        if(!congested.load(std::memory_order_acquire)) {
+            return true;
+        }
+
+        queue.push_back(std::move(callback));
+        return false;
+    });
+
+    if(ready) {
+        callback();
+    }
+}
+
+void
+session_t::congest(bool value) {
+    if(value) {
+        COCAINE_LOG_DEBUG(log, "outgoing data has reached the high watermark");
+        congested.store(true, std::memory_order_release);
+        return;
+    }
+
+    std::vector<std::function<void()>> ready;
+
+    // The flag is lowered under the lock, so that no callback could be left waiting.
+    waiters.apply([&](std::vector<std::function<void()>>& queue) {
+        congested.store(false, std::memory_order_release);
+        ready.swap(queue);
+    });
+
+    for(auto it = ready.begin(); it != ready.end(); ++it) {
+        (*it)();
+    }
+
+    resume();
+}
+
+void
+session_t::set_max_channels(std::size_t limit) {
+    max_channels = limit;
+}
+
+bool
+session_t::saturated() const {
+    return congested.load(std::memory_order_acquire);
+}
+
+bool
+session_t::pause(const std::shared_ptr<pull_action_t>& action) {
+    return paused.apply([&](std::shared_ptr<pull_action_t>& slot) {
+        // Checked again under the lock, as the session might have been drained in the meantime.
+        if(!saturated()) {
+            return false;
+        }
+
+        slot = action;
+        return true;
+    });
+}
+
+void
+session_t::resume() {
+    const auto action = paused.apply([&](std::shared_ptr<pull_action_t>& slot) {
+        if(!slot || saturated()) {
+            return std::shared_ptr<pull_action_t>();
+        }
+
+        return std::move(slot);
+    });
+
+    if(!action) {
+        return;
+    }
+
+#if defined(__clang__)
+    if(const auto ptr = std::atomic_load(&transport)) {
+#else
+    if(const auto ptr = *transport.synchronize()) {
+#endif
+        COCAINE_LOG_DEBUG(log, "resuming the message pump");
+
+        // Use post() to avoid nesting the pump into the caller.
+        reactor.post(std::bind(&pull_action_t::operator(), action, ptr));
+    }
+}
+
 void
 session_t::pull() {
 #if defined(__clang__)
@@ -485,20 +1048,104 @@ session_t::pull() {
 
 void
 session_t::push(encoder_t::message_type&& message) {
+    if(detached.load(std::memory_order_acquire)) {
+        throw std::system_error(error::not_connected);
+    }
+
+    outgoing.push(outgoing_t{std::move(message), trace_t::current()});
+
+    // NOTE: Only the producer which has raised the flag schedules the flush, others just leave their
+    // messages in the queue. The flag is lowered by the flush once the queue is drained.
+    if(!flushing.exchange(true, std::memory_order_acq_rel)) {
+        reactor.post(std::bind(&session_t::flush, shared_from_this()));
+    }
+}
+
+void
+session_t::flush() {
 #if defined(__clang__)
-    if(const auto ptr = std::atomic_load(&transport)) {
+    const auto ptr = std::atomic_load(&transport);
 #else
-    if(const auto ptr = *transport.synchronize()) {
+    const auto ptr = *transport.synchronize();
 #endif
-        // Use post() instead of a direct call for thread safety.
-        // We can not use dispatch here to prevent channel reordering.
-        ptr->socket->get_io_service().post(trace_t::bind(&push_action_t::operator(),
-            std::make_shared<push_action_t>(std::move(message), shared_from_this()),
-            ptr
-        ));
+
+    boost::optional<outgoing_t> last;
+    std::size_t count = 0;
+
+    for(; count < batch; ++count) {
+        auto next = outgoing.pop();
+
+        if(!next) {
+            break;
+        }
+
+        if(last && ptr) {
+            // Completions are only tracked for the last message of the batch, see below.
+            send(ptr, *last, nullptr);
+        }
+
+        last = std::move(next);
+    }
+
+    if(last && ptr) {
+        // Writes are performed in order and a failure is reported to every pending handler, so the
+        // handler of the last message is enough to detect errors for the whole batch.
+        send(ptr, *last, std::bind(&session_t::sent, shared_from_this(), std::placeholders::_1));
+
+        if(write_limit && ptr->writer->pressure() > write_limit) {
+            COCAINE_LOG_ERROR(log, "client disconnected: {:d} bytes pending to be written",
+                ptr->writer->pressure());
+            detach(error::slow_consumer);
+        }
+    }
+
+    if(count < batch || outgoing.empty()) {
+        flushing.exchange(false, std::memory_order_acq_rel);
+
+        // Some producer might have pushed a message after the queue has been drained, but before the
+        // flag was lowered, in which case it relies on this flush to handle it.
+        if(outgoing.empty() || flushing.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+    }
+
+    // Give other sessions a chance to run before continuing.
+    reactor.post(std::bind(&session_t::flush, shared_from_this()));
+}
+
+void
+session_t::send(const std::shared_ptr<transport_type>& ptr, const outgoing_t& outgoing,
+                std::function<void(const std::error_code&)> handle)
+{
+    trace_t::restore_scope_t trace_scope(outgoing.trace);
+
+    if(!trace_t::current().empty()) {
+        if(trace_t::current().pushed()) {
+            COCAINE_LOG_DEBUG(log, "cs");
+        } else {
+            COCAINE_LOG_DEBUG(log, "ss");
+        }
+    }
+
+    if(handle) {
+        handle = trace_t::bind(std::move(handle));
+    }
+
+    ptr->writer->write(outgoing.message, std::move(handle));
+}
+
+void
+session_t::sent(const std::error_code& ec) {
+    COCAINE_LOG_DEBUG(log, "after send");
+    if(ec.value() == 0) return;
+
+    if(ec != asio::error::eof) {
+        COCAINE_LOG_ERROR(log, "client disconnected: [{:d}] {}", ec.value(), ec.message());
     } else {
-        throw std::system_error(error::not_connected);
+        COCAINE_LOG_DEBUG(log, "client disconnected");
     }
+
+    return detach(ec);
 }
 
 void
@@ -508,6 +1155,7 @@ session_t::detach(const std::error_code& ec) {
 #else
     if(auto swapped = std::move(*transport.synchronize())) {
 #endif
+        detached.store(true, std::memory_order_release);
         swapped = nullptr;
         COCAINE_LOG_DEBUG(log, "detached session from the transport");
     } else {
@@ -523,11 +1171,19 @@ session_t::detach(const std::error_code& ec) {
         }
 
         for(auto it = mapping.begin(); it != mapping.end(); ++it) {
-            if(it->second->dispatch) it->second->dispatch->discard(ec);
+            if(it.value()->dispatch) it.value()->dispatch->discard(ec);
         }
 
         mapping.clear();
     });
+
+    // Wake up everyone waiting for the session to become writable, so that they find out it's gone.
+    congest(false);
+
+    // The paused message pump, if any, holds a reference to the session.
+    paused.synchronize()->reset();
+
+    windows.synchronize()->clear();
 }
 
 // Information
@@ -538,7 +1194,7 @@ session_t::active_channels() const {
         std::map<uint64_t, std::string> result;
 
         for(auto it = mapping.begin(); it != mapping.end(); ++it) {
-            result[it->first] = dispatch_name(it->second->dispatch);
+            result[it.key()] = dispatch_name(it.value()->dispatch);
         }
 
         return result;
@@ -558,6 +1214,11 @@ session_t::memory_pressure() const {
     }
 }
 
+bool
+session_t::writable() const {
+    return !congested.load(std::memory_order_acquire);
+}
+
 std::string
 session_t::name() const {
     return dispatch_name(prototype);
@@ -0,0 +1,97 @@
+/*
+    Copyright (c) 2011-2016 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/rpc/slice.hpp"
+
+#include <boost/thread/tss.hpp>
+
+#include <cstring>
+
+using namespace cocaine::io;
+
+namespace {
+
+typedef std::shared_ptr<const void> owner_type;
+
+void
+noop_cleanup(owner_type*) {
+    // Scopes are allocated on the stack.
+}
+
+auto
+current_owner() -> boost::thread_specific_ptr<owner_type>& {
+    static boost::thread_specific_ptr<owner_type> owner(&noop_cleanup);
+    return owner;
+}
+
+} // namespace
+
+slice_t::slice_t():
+    m_data(nullptr),
+    m_size(0)
+{ }
+
+slice_t::slice_t(std::shared_ptr<const void> owner, const char* data, size_t size):
+    m_owner(std::move(owner)),
+    m_data(data),
+    m_size(size)
+{ }
+
+slice_t::slice_t(std::string value) {
+    auto owner = std::make_shared<const std::string>(std::move(value));
+
+    m_data  = owner->data();
+    m_size  = owner->size();
+    m_owner = std::move(owner);
+}
+
+slice_t::operator std::string() const {
+    return to_string();
+}
+
+auto
+slice_t::to_string() const -> std::string {
+    return std::string(m_data, m_size);
+}
+
+bool
+slice_t::operator==(const slice_t& other) const {
+    return m_size == other.m_size && (m_size == 0 || std::memcmp(m_data, other.m_data, m_size) == 0);
+}
+
+bool
+slice_t::operator!=(const slice_t& other) const {
+    return !operator==(other);
+}
+
+slice_t::scope_t::scope_t(const std::shared_ptr<const void>& owner):
+    m_previous(current_owner().get())
+{
+    // NOTE: The owner is never modified through the stored pointer.
+    current_owner().reset(owner ? const_cast<owner_type*>(&owner) : nullptr);
+}
+
+slice_t::scope_t::~scope_t() {
+    current_owner().reset(const_cast<owner_type*>(m_previous));
+}
+
+auto
+slice_t::scope_t::current() -> const std::shared_ptr<const void>* {
+    return current_owner().get();
+}
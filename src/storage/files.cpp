@@ -21,6 +21,8 @@
 #include "cocaine/detail/storage/files.hpp"
 
 #include "cocaine/context.hpp"
+#include "cocaine/context/config.hpp"
+#include "cocaine/cpuset.hpp"
 #include "cocaine/dynamic.hpp"
 #include "cocaine/logging.hpp"
 
@@ -45,9 +47,10 @@ files_t::files_t(context_t& context, const std::string& name, const dynamic_t& a
     m_parent_path(args.as_object().at("path").as_string()),
     io_loop(),
     io_work(asio::io_service::work(io_loop)),
-    thread([&](){
+    thread([this](const cpuset_t& cpus){
+        cpus.apply();
         io_loop.run();
-    })
+    }, context.config().threads().executors())
 { }
 
 files_t::~files_t() {
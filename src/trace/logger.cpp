@@ -21,6 +21,8 @@
 #include "cocaine/context/filter.hpp"
 #include "cocaine/trace/logger.hpp"
 
+#include <limits>
+
 using namespace blackhole;
 
 namespace cocaine { namespace logging {
@@ -39,7 +41,8 @@ namespace {
 
 trace_wrapper_t::trace_wrapper_t(std::unique_ptr<blackhole::logger_t> log):
     inner(std::move(log)),
-    m_filter(new filter_t([](severity_t, attribute_pack&) { return true; }))
+    m_filter(new filter_t([](severity_t, attribute_pack&) { return true; })),
+    m_threshold(std::numeric_limits<severity_t>::min())
 {
 }
 
@@ -52,12 +55,21 @@ auto trace_wrapper_t::attributes() const noexcept -> blackhole::attributes_t {
 }
 
 auto trace_wrapper_t::filter(filter_t new_filter) -> void {
+    filter(std::move(new_filter), std::numeric_limits<severity_t>::min());
+}
+
+auto trace_wrapper_t::filter(filter_t new_filter, severity_t threshold) -> void {
     std::shared_ptr<filter_t> new_filter_ptr(new filter_t(std::move(new_filter)));
     m_filter.apply([&](std::shared_ptr<filter_t>& filter_ptr){
         filter_ptr.swap(new_filter_ptr);
+        m_threshold.store(threshold, std::memory_order_release);
     });
 }
 
+auto trace_wrapper_t::enabled(severity_t severity) const -> bool {
+    return severity >= m_threshold.load(std::memory_order_acquire) || trace_t::current().verbose();
+}
+
 auto trace_wrapper_t::log(severity_t severity, const message_t& message) -> void {
     attribute_pack pack;
     log(severity, message, pack);
@@ -87,4 +99,50 @@ auto trace_wrapper_t::manager() -> scope::manager_t& {
     return inner->manager();
 }
 
+lazy_wrapper_t::lazy_wrapper_t(std::shared_ptr<blackhole::logger_t> log, gate_type gate_, factory_type factory_):
+    inner(std::move(log)),
+    gate(std::move(gate_)),
+    factory(std::move(factory_))
+{
+}
+
+auto lazy_wrapper_t::attributes() -> const attribute_list& {
+    std::call_once(initialized, [this] {
+        storage = factory();
+        view = gen_view(storage);
+
+        // Release whatever the factory has captured, it's not needed anymore.
+        factory = nullptr;
+    });
+
+    return view;
+}
+
+auto lazy_wrapper_t::log(severity_t severity, const message_t& message) -> void {
+    attribute_pack pack;
+    log(severity, message, pack);
+}
+
+auto lazy_wrapper_t::log(severity_t severity, const message_t& message, attribute_pack& pack) -> void {
+    if(!gate(severity)) {
+        return;
+    }
+
+    pack.push_back(attributes());
+    inner->log(severity, message, pack);
+}
+
+auto lazy_wrapper_t::log(severity_t severity, const lazy_message_t& message, attribute_pack& pack) -> void {
+    if(!gate(severity)) {
+        return;
+    }
+
+    pack.push_back(attributes());
+    inner->log(severity, message, pack);
+}
+
+auto lazy_wrapper_t::manager() -> scope::manager_t& {
+    return inner->manager();
+}
+
 }} // namespace cocaine::logging
@@ -0,0 +1,541 @@
+/*
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/rpc/asio/uring.hpp"
+
+#include <asio/io_service.hpp>
+#include <asio/posix/stream_descriptor.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <system_error>
+#include <vector>
+
+#if defined(COCAINE_HAS_FEATURE_IO_URING)
+    #include <linux/io_uring.h>
+
+    #include <sys/eventfd.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <sys/utsname.h>
+
+    #include <unistd.h>
+#endif
+
+using namespace cocaine::io;
+
+auto
+uring_t::operation_t::message() -> const msghdr* {
+    return nullptr;
+}
+
+auto
+uring_t::operation_t::active() const -> bool {
+    return true;
+}
+
+#if defined(COCAINE_HAS_FEATURE_IO_URING)
+
+namespace {
+
+// Raw system calls, as only a tiny subset of liburing is needed here.
+
+int
+setup(unsigned entries, io_uring_params* params) {
+    return ::syscall(__NR_io_uring_setup, entries, params);
+}
+
+int
+enter(int fd, unsigned submit, unsigned wait, unsigned flags) {
+    return ::syscall(__NR_io_uring_enter, fd, submit, wait, flags, nullptr, 0);
+}
+
+int
+enroll(int fd, unsigned opcode, void* arg, unsigned count) {
+    return ::syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+void
+check(bool success, const char* what) {
+    if(!success) {
+        throw std::system_error(errno, std::system_category(), what);
+    }
+}
+
+// Memory region shared with the kernel.
+struct mapping_t {
+    void*  data;
+    size_t size;
+
+    mapping_t(): data(MAP_FAILED), size(0) { }
+
+   ~mapping_t() {
+        if(data != MAP_FAILED) {
+            ::munmap(data, size);
+        }
+    }
+
+    void
+    map(int fd, size_t size_, off_t offset, const char* what) {
+        const int flags = fd < 0 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_SHARED | MAP_POPULATE;
+
+        size = size_;
+        data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, fd, offset);
+
+        check(data != MAP_FAILED, what);
+    }
+
+    template<class T>
+    T*
+    at(size_t offset) const {
+        return reinterpret_cast<T*>(static_cast<char*>(data) + offset);
+    }
+};
+
+// Multishot receives showed up in Linux 6.0. Unlike opcodes, request flags can't be probed for, so
+// the kernel version is checked instead.
+bool
+multishot_supported() {
+    utsname name;
+    unsigned major = 0;
+
+    return ::uname(&name) == 0 && std::sscanf(name.release, "%u", &major) == 1 && major >= 6;
+}
+
+const unsigned short kBufferGroup = 0;
+
+} // namespace
+
+struct uring_t::state_t {
+    explicit
+    state_t(asio::io_service& asio_):
+        asio(asio_),
+        fd(-1),
+        events(asio_),
+        waiting(false),
+        scheduled(false),
+        submitted(0),
+        reaped(0)
+    { }
+
+   ~state_t() {
+        if(fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    asio::io_service& asio;
+
+    int fd;
+
+    // Submission queue.
+    mapping_t rings, sqes;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_flags;
+    unsigned  sq_mask;
+    unsigned  sq_entries;
+
+    // Completion queue, lives in the same mapping.
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned  cq_mask;
+
+    io_uring_cqe* cqes;
+
+    // Provided buffers and the ring they are handed out to the kernel through.
+    mapping_t buffers, buffer_ring;
+    unsigned short buffer_tail;
+
+    // The kernel signals this descriptor whenever a completion is posted.
+    asio::posix::stream_descriptor events;
+    std::uint64_t counter;
+    bool waiting;
+
+    struct request_t {
+        int opcode;
+        int fd;
+        operation_t* operation;
+    };
+
+    // Requests issued during the current reactor turn.
+    std::vector<request_t> pending;
+    bool scheduled;
+
+    std::uint64_t submitted;
+    std::uint64_t reaped;
+
+    void
+    recycle(unsigned short id) {
+        auto buffer = buffer_ring.at<io_uring_buf>(0) + (buffer_tail & (kBuffers - 1));
+
+        buffer->addr = reinterpret_cast<std::uintptr_t>(buffers.at<char>(id * kBufferSize));
+        buffer->len  = kBufferSize;
+        buffer->bid  = id;
+
+        __atomic_store_n(&buffer_ring.at<io_uring_buf_ring>(0)->tail, ++buffer_tail, __ATOMIC_RELEASE);
+    }
+
+    auto
+    next() -> io_uring_sqe* {
+        const unsigned tail = *sq_tail;
+
+        if(tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) == sq_entries) {
+            return nullptr;
+        }
+
+        auto sqe = sqes.at<io_uring_sqe>(0) + (tail & sq_mask);
+
+        std::memset(sqe, 0, sizeof(*sqe));
+
+        // The tail is published on submission.
+        *sq_tail = tail + 1;
+
+        return sqe;
+    }
+
+    // Returns false if the kernel can't take more requests until some completions are reaped.
+    bool
+    submit() {
+        __atomic_store_n(sq_tail, *sq_tail, __ATOMIC_RELEASE);
+
+        while(const unsigned count = *sq_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE)) {
+            const int rv = enter(fd, count, 0, 0);
+
+            if(rv < 0) {
+                if(errno == EINTR) {
+                    continue;
+                }
+
+                if(errno == EAGAIN || errno == EBUSY) {
+                    return false;
+                }
+
+                throw std::system_error(errno, std::system_category(), "unable to submit io_uring requests");
+            }
+
+            submitted += rv;
+        }
+
+        return true;
+    }
+};
+
+uring_t::uring_t(asio::io_service& asio):
+    state(new state_t(asio))
+{
+    if(!multishot_supported()) {
+        throw std::system_error(ENOSYS, std::system_category(), "multishot receives require Linux 6.0");
+    }
+
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = kEntries * 4;
+
+    check((state->fd = setup(kEntries, &params)) >= 0, "unable to set up io_uring");
+
+    if(!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)) {
+        throw std::system_error(ENOSYS, std::system_category(), "io_uring is too old");
+    }
+
+    state->rings.map(state->fd, std::max(
+        params.sq_off.array + params.sq_entries * sizeof(unsigned),
+        params.cq_off.cqes  + params.cq_entries * sizeof(io_uring_cqe)
+    ), IORING_OFF_SQ_RING, "unable to map io_uring queues");
+
+    state->sqes.map(state->fd, params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES,
+        "unable to map io_uring submission entries");
+
+    const auto& rings = state->rings;
+
+    state->sq_head    = rings.at<unsigned>(params.sq_off.head);
+    state->sq_tail    = rings.at<unsigned>(params.sq_off.tail);
+    state->sq_flags   = rings.at<unsigned>(params.sq_off.flags);
+    state->sq_mask    = *rings.at<unsigned>(params.sq_off.ring_mask);
+    state->sq_entries = *rings.at<unsigned>(params.sq_off.ring_entries);
+
+    // Submission entries are used in order, so the indirection array is identity.
+    for(unsigned i = 0; i < state->sq_entries; ++i) {
+        rings.at<unsigned>(params.sq_off.array)[i] = i;
+    }
+
+    state->cq_head = rings.at<unsigned>(params.cq_off.head);
+    state->cq_tail = rings.at<unsigned>(params.cq_off.tail);
+    state->cq_mask = *rings.at<unsigned>(params.cq_off.ring_mask);
+    state->cqes    = rings.at<io_uring_cqe>(params.cq_off.cqes);
+
+    // Provided buffers, available since Linux 5.19.
+    state->buffers.map(-1, kBuffers * kBufferSize, 0, "unable to allocate io_uring buffers");
+    state->buffer_ring.map(-1, kBuffers * sizeof(io_uring_buf), 0, "unable to allocate io_uring buffer ring");
+
+    io_uring_buf_reg registration;
+    std::memset(&registration, 0, sizeof(registration));
+
+    registration.ring_addr = reinterpret_cast<std::uintptr_t>(state->buffer_ring.data);
+    registration.ring_entries = kBuffers;
+    registration.bgid = kBufferGroup;
+
+    check(enroll(state->fd, IORING_REGISTER_PBUF_RING, &registration, 1) == 0,
+        "unable to register io_uring buffer ring");
+
+    state->buffer_tail = 0;
+
+    for(unsigned i = 0; i < kBuffers; ++i) {
+        state->recycle(i);
+    }
+
+    int events = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    check(events >= 0, "unable to create io_uring eventfd");
+
+    state->events.assign(events);
+
+    check(enroll(state->fd, IORING_REGISTER_EVENTFD, &events, 1) == 0,
+        "unable to register io_uring eventfd");
+}
+
+uring_t::~uring_t() {
+    // Pending completions are dropped along with the ring, the operations are long gone by now as
+    // they keep the instance alive while armed.
+}
+
+void
+uring_t::recv(int fd, operation_t& operation) {
+    schedule(IORING_OP_RECV, fd, &operation);
+}
+
+void
+uring_t::send(int fd, operation_t& operation) {
+    schedule(IORING_OP_SENDMSG, fd, &operation);
+}
+
+void
+uring_t::cancel(operation_t& operation) {
+    schedule(IORING_OP_ASYNC_CANCEL, -1, &operation);
+}
+
+auto
+uring_t::submissions() const -> std::uint64_t {
+    return state->submitted;
+}
+
+auto
+uring_t::completions() const -> std::uint64_t {
+    return state->reaped;
+}
+
+void
+uring_t::schedule(int opcode, int fd, operation_t* operation) {
+    state->pending.push_back({opcode, fd, operation});
+
+    if(!state->waiting) {
+        wait();
+    }
+
+    if(!state->scheduled) {
+        state->scheduled = true;
+        state->asio.post(std::bind(&uring_t::flush, shared_from_this()));
+    }
+}
+
+void
+uring_t::flush() {
+    state->scheduled = false;
+
+    // Requests dropped instead of being submitted, completed once the queue is consistent again.
+    std::vector<operation_t*> dropped;
+
+    auto it = state->pending.begin();
+
+    for(; it != state->pending.end(); ++it) {
+        if(it->opcode != IORING_OP_ASYNC_CANCEL && !it->operation->active()) {
+            dropped.push_back(it->operation);
+            continue;
+        }
+
+        io_uring_sqe* sqe = state->next();
+
+        if(!sqe) {
+            // The submission queue is full, make some room first.
+            if(!state->submit() || (sqe = state->next()) == nullptr) {
+                break;
+            }
+        }
+
+        sqe->opcode = it->opcode;
+        sqe->fd = it->fd;
+
+        switch(it->opcode) {
+        case IORING_OP_RECV:
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = kBufferGroup;
+            sqe->user_data = reinterpret_cast<std::uintptr_t>(it->operation);
+            break;
+        case IORING_OP_SENDMSG:
+            sqe->addr = reinterpret_cast<std::uintptr_t>(it->operation->message());
+            sqe->len = 1;
+            sqe->msg_flags = MSG_NOSIGNAL;
+            sqe->user_data = reinterpret_cast<std::uintptr_t>(it->operation);
+            break;
+        case IORING_OP_ASYNC_CANCEL:
+            // The completion of the cancellation request itself is of no interest.
+            sqe->addr = reinterpret_cast<std::uintptr_t>(it->operation);
+            sqe->user_data = 0;
+            break;
+        }
+    }
+
+    const bool accepted = state->submit();
+
+    state->pending.erase(state->pending.begin(), it);
+
+    if(!accepted || !state->pending.empty()) {
+        // The kernel is out of room for completions, retry once they're reaped.
+        reap();
+
+        state->scheduled = true;
+        state->asio.post(std::bind(&uring_t::flush, shared_from_this()));
+    }
+
+    for(auto operation: dropped) {
+        operation->complete(-ECANCELED, nullptr, false);
+    }
+}
+
+void
+uring_t::wait() {
+    std::weak_ptr<uring_t> weak(shared_from_this());
+
+    state->waiting = true;
+
+    // NOTE: Reading the eventfd, unlike waiting for readiness, is attempted right away, so that the
+    // notifications posted between the last reaping and this call are not lost.
+    state->events.async_read_some(asio::buffer(&state->counter, sizeof(state->counter)),
+        [weak](const std::error_code& ec, size_t)
+    {
+        if(ec == asio::error::operation_aborted) {
+            return;
+        }
+
+        if(auto self = weak.lock()) {
+            self->state->waiting = false;
+            self->reap();
+
+            if(!self->state->waiting) {
+                self->wait();
+            }
+        }
+    });
+}
+
+void
+uring_t::reap() {
+    unsigned head = *state->cq_head;
+
+    while(true) {
+        const unsigned tail = __atomic_load_n(state->cq_tail, __ATOMIC_ACQUIRE);
+
+        if(head == tail) {
+            if(__atomic_load_n(state->sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW) {
+                // Completions which didn't fit into the queue are flushed into it on the next enter.
+                enter(state->fd, 0, 0, IORING_ENTER_GETEVENTS);
+                continue;
+            }
+
+            break;
+        }
+
+        const io_uring_cqe& cqe = state->cqes[head & state->cq_mask];
+
+        const auto operation = reinterpret_cast<operation_t*>(cqe.user_data);
+        const auto result = cqe.res;
+        const auto flags = cqe.flags;
+
+        __atomic_store_n(state->cq_head, ++head, __ATOMIC_RELEASE);
+
+        state->reaped++;
+
+        if(!operation) {
+            continue;
+        }
+
+        const bool more = flags & IORING_CQE_F_MORE;
+
+        if(flags & IORING_CQE_F_BUFFER) {
+            const unsigned short id = flags >> IORING_CQE_BUFFER_SHIFT;
+
+            operation->complete(result, state->buffers.at<char>(id * kBufferSize), more);
+
+            // Handed back only after the data is consumed, as the kernel might reuse it right away.
+            state->recycle(id);
+        } else {
+            operation->complete(result, nullptr, more);
+        }
+    }
+}
+
+#else
+
+struct uring_t::state_t { };
+
+uring_t::uring_t(asio::io_service&) {
+    throw std::system_error(std::make_error_code(std::errc::function_not_supported),
+        "io_uring is not supported on this platform");
+}
+
+uring_t::~uring_t() { }
+
+void
+uring_t::recv(int, operation_t&) { }
+
+void
+uring_t::send(int, operation_t&) { }
+
+void
+uring_t::cancel(operation_t&) { }
+
+auto
+uring_t::submissions() const -> std::uint64_t {
+    return 0;
+}
+
+auto
+uring_t::completions() const -> std::uint64_t {
+    return 0;
+}
+
+void
+uring_t::schedule(int, int, operation_t*) { }
+
+void
+uring_t::flush() { }
+
+void
+uring_t::wait() { }
+
+void
+uring_t::reap() { }
+
+#endif
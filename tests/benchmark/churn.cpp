@@ -0,0 +1,163 @@
+/*
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/context.hpp"
+#include "cocaine/context/config.hpp"
+#include "cocaine/engine.hpp"
+#include "cocaine/errors.hpp"
+#include "cocaine/idl/storage.hpp"
+
+#include "cocaine/rpc/asio/decoder.hpp"
+#include "cocaine/rpc/asio/encoder.hpp"
+#include "cocaine/rpc/dispatch.hpp"
+
+#include <asio/io_service.hpp>
+#include <asio/ip/tcp.hpp>
+#include <asio/write.hpp>
+
+#include <blackhole/root.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <celero/Celero.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+using namespace cocaine;
+
+namespace fs = boost::filesystem;
+namespace ip = asio::ip;
+
+// Minimal configuration with a single execution unit and no services, where logs are discarded.
+const char kConfig[] = R"({
+    "version": 4,
+    "paths": {"plugins": [], "runtime": "/tmp"},
+    "network": {"pool": 1},
+    "logging": {"loggers": {}}
+})";
+
+// Connects and disconnects clients one by one. Connections are either just accepted and closed, or
+// handed over to an execution unit the same way actors do, which then serves one request on each
+// of them. Celero reports the result in connections per second.
+struct churn_fixture_t:
+    public celero::TestFixture
+{
+    std::unique_ptr<context_t> context;
+
+    std::unique_ptr<asio::io_service> asio;
+    std::unique_ptr<ip::tcp::acceptor> acceptor;
+
+    io::dispatch_ptr_t prototype;
+
+    std::string request;
+    std::vector<char> reply;
+
+    virtual
+    void
+    setUp(int64_t) {
+        const auto path = fs::temp_directory_path() / fs::unique_path("cocaine-churn-%%%%%%%%.conf");
+
+        {
+            fs::ofstream stream(path);
+            stream << kConfig;
+        }
+
+        auto config = make_config(path.string());
+        fs::remove(path);
+
+        context = make_context(std::move(config), std::make_unique<blackhole::root_logger_t>(
+            std::vector<std::unique_ptr<blackhole::handler_t>>()
+        ));
+
+        asio.reset(new asio::io_service());
+        acceptor.reset(new ip::tcp::acceptor(*asio, ip::tcp::endpoint(ip::address_v4::loopback(), 0)));
+
+        auto dispatch = std::make_shared<cocaine::dispatch<io::storage_tag>>("churn");
+        dispatch->on<io::storage::read>([](const std::string&, const std::string&) -> std::string {
+            return "value";
+        });
+
+        prototype = std::move(dispatch);
+
+        const auto encoded = io::encoder_t().encode(io::encoded<io::storage::read>(1, "collection", "key"));
+        request.assign(encoded.data(), encoded.size());
+
+        reply.resize(4096);
+    }
+
+    virtual
+    void
+    tearDown() {
+        prototype.reset();
+        acceptor.reset();
+        asio.reset();
+        context.reset();
+    }
+
+    void
+    churn(bool attach) {
+        ip::tcp::socket client(*asio);
+        client.connect(acceptor->local_endpoint());
+
+        const int fd = ::accept4(acceptor->native_handle(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if(fd == -1) {
+            throw std::system_error(errno, std::system_category(), "unable to accept connection");
+        }
+
+        if(!attach) {
+            ::close(fd);
+            return;
+        }
+
+        context->engine().attach(ip::tcp::v4(), fd, prototype);
+
+        asio::write(client, asio::buffer(request));
+
+        // Wait for the reply, so that the request is surely served before the client disconnects.
+        io::decoder_t decoder;
+        io::decoder_t::message_type message;
+
+        std::error_code ec;
+        size_t size = 0;
+
+        do {
+            size += client.read_some(asio::buffer(reply.data() + size, reply.size() - size));
+            decoder.decode(reply.data(), size, message, ec);
+        } while(ec == error::insufficient_bytes);
+
+        if(ec) {
+            throw std::system_error(ec, "unable to decode the reply");
+        }
+    }
+};
+
+} // namespace
+
+BASELINE_F (ConnectionChurn, Accept,  churn_fixture_t, 10, 10000) {
+    churn(false);
+}
+
+BENCHMARK_F(ConnectionChurn, Session, churn_fixture_t, 10, 10000) {
+    churn(true);
+}
@@ -0,0 +1,141 @@
+/*
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/idl/streaming.hpp"
+
+#include "cocaine/rpc/asio/encoder.hpp"
+#include "cocaine/rpc/asio/writable_stream.hpp"
+
+#include <asio/io_service.hpp>
+#include <asio/local/connect_pair.hpp>
+#include <asio/local/stream_protocol.hpp>
+
+#include "measurement.hpp"
+
+#include <fstream>
+
+namespace {
+
+using namespace cocaine;
+
+typedef io::streaming<boost::mpl::list<std::string>::type> protocol_type;
+
+typedef asio::local::stream_protocol::socket socket_type;
+typedef io::writable_stream<asio::local::stream_protocol, io::encoder_t> stream_type;
+
+// Number of chunks a streaming service sends in one reactor turn.
+const size_t kBurstSize = 32;
+
+// Returns the number of write-like system calls issued by this process so far.
+size_t
+write_syscalls() {
+    std::ifstream stream("/proc/self/io");
+    std::string key;
+    size_t value = 0;
+
+    while(stream >> key >> value) {
+        if(key == "syscw:") {
+            return value;
+        }
+    }
+
+    return 0;
+}
+
+// Writes bursts of small chunks into a stream and reports the number of write syscalls per chunk.
+template<size_t CorkBytes>
+struct coalescing_fixture_t:
+    public benchmark::measured_fixture_t
+{
+    std::unique_ptr<asio::io_service> asio;
+    std::shared_ptr<socket_type> client;
+    std::unique_ptr<socket_type> server;
+    std::shared_ptr<stream_type> stream;
+
+    std::vector<char> buffer;
+
+    size_t messages;
+    size_t syscalls;
+
+    coalescing_fixture_t():
+        measured_fixture_t("write syscalls per message")
+    { }
+
+    virtual
+    void
+    setUp(int64_t) {
+        asio.reset(new asio::io_service());
+        client = std::make_shared<socket_type>(*asio);
+        server.reset(new socket_type(*asio));
+
+        asio::local::connect_pair(*client, *server);
+
+        client->non_blocking(true);
+
+        stream = std::make_shared<stream_type>(client);
+        stream->set_coalescing(CorkBytes, boost::posix_time::time_duration());
+
+        buffer.resize(65536);
+
+        messages = 0;
+        syscalls = write_syscalls();
+    }
+
+    virtual
+    void
+    tearDown() {
+        if(messages) {
+            report(double(write_syscalls() - syscalls) / messages);
+        }
+
+        stream.reset();
+        server.reset();
+        client.reset();
+        asio.reset();
+    }
+
+    void
+    burst() {
+        for(size_t i = 0; i < kBurstSize; ++i) {
+            stream->write(io::encoded<protocol_type::chunk>(1, std::string("chunk")), nullptr);
+        }
+
+        asio->run();
+        asio->reset();
+
+        messages += kBurstSize;
+
+        while(server->available()) {
+            server->read_some(asio::buffer(buffer));
+        }
+    }
+};
+
+typedef coalescing_fixture_t<0>     immediate_fixture_t;
+typedef coalescing_fixture_t<65536> coalesced_fixture_t;
+
+} // namespace
+
+BASELINE_F (WriteCoalescing, Immediate, immediate_fixture_t, 10, 10000) {
+    burst();
+}
+
+BENCHMARK_F(WriteCoalescing, Coalesced, coalesced_fixture_t, 10, 10000) {
+    burst();
+}
@@ -0,0 +1,143 @@
+/*
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/idl/streaming.hpp"
+
+#include "cocaine/rpc/asio/encoder.hpp"
+
+#include "cocaine/trace/trace.hpp"
+
+#include "measurement.hpp"
+
+namespace {
+
+using namespace cocaine;
+
+typedef io::streaming<boost::mpl::list<std::string>::type> protocol_type;
+
+// Encodes small RPCs, which are mostly header bytes, and reports the average frame size along with
+// the timings.
+template<bool Compression>
+struct encoder_fixture_t:
+    public benchmark::measured_fixture_t
+{
+    std::unique_ptr<io::encoder_t> encoder;
+    std::unique_ptr<trace_t::restore_scope_t> scope;
+
+    hpack::headers_t headers;
+
+    size_t frames;
+    size_t bytes;
+
+    encoder_fixture_t():
+        measured_fixture_t("bytes per frame")
+    { }
+
+    virtual
+    void
+    setUp(int64_t) {
+        encoder.reset(new io::encoder_t());
+        encoder->set_compression(Compression);
+
+        // Every frame carries tracing headers of the same trace.
+        scope.reset(new trace_t::restore_scope_t(trace_t::generate("benchmark")));
+
+        headers = {
+            hpack::header_t("authorization", "TVM 3:serv:CBAQ__________9_IgQIARAC"),
+            hpack::header_t("x-request-id", "0123456789abcdef")
+        };
+
+        frames = bytes = 0;
+    }
+
+    virtual
+    void
+    tearDown() {
+        if(frames) {
+            report(double(bytes) / frames);
+        }
+
+        scope.reset();
+    }
+
+    void
+    encode() {
+        const auto message = encoder->encode(io::encoded<protocol_type::chunk>(1, headers, std::string("ping")));
+
+        frames += 1;
+        bytes  += message.size();
+    }
+};
+
+typedef encoder_fixture_t<false> uncompressed_fixture_t;
+typedef encoder_fixture_t<true>  compressed_fixture_t;
+
+// Keeps the dynamic table full of distinct headers, like a long-living connection would.
+struct table_fixture_t:
+    public celero::TestFixture
+{
+    std::unique_ptr<hpack::header_table_t> table;
+    std::vector<hpack::header_t> headers;
+
+    size_t counter;
+
+    virtual
+    void
+    setUp(int64_t) {
+        table.reset(new hpack::header_table_t());
+        headers.clear();
+
+        for(size_t i = 0; i < 256; ++i) {
+            headers.emplace_back("x-header-" + std::to_string(i % 16), std::to_string(i));
+        }
+
+        for(const auto& header: headers) {
+            table->push(header);
+        }
+
+        counter = 0;
+    }
+
+    auto
+    next() -> const hpack::header_t& {
+        return headers[counter++ % headers.size()];
+    }
+};
+
+} // namespace
+
+BASELINE_F (EncoderHeaders, Uncompressed, uncompressed_fixture_t, 10, 100000) {
+    encode();
+}
+
+BENCHMARK_F(EncoderHeaders, Compressed,   compressed_fixture_t,   10, 100000) {
+    encode();
+}
+
+BASELINE_F (HeaderTable, Push,            table_fixture_t, 10, 1000000) {
+    table->push(next());
+}
+
+BENCHMARK_F(HeaderTable, FindByFullMatch, table_fixture_t, 10, 1000000) {
+    celero::DoNotOptimizeAway(table->find_by_full_match(next()));
+}
+
+BENCHMARK_F(HeaderTable, FindByName,      table_fixture_t, 10, 1000000) {
+    celero::DoNotOptimizeAway(table->find_by_name(next()));
+}
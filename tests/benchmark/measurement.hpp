@@ -0,0 +1,78 @@
+/*
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COCAINE_BENCHMARK_MEASUREMENT_HPP
+#define COCAINE_BENCHMARK_MEASUREMENT_HPP
+
+#include <celero/Celero.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cocaine { namespace benchmark {
+
+// Fixture reporting one extra value per sample, like bytes or syscalls per operation, which celero
+// then prints in its own table along with the timings.
+struct measured_fixture_t:
+    public celero::TestFixture
+{
+    explicit
+    measured_fixture_t(std::string name):
+        measurement(std::make_shared<measurement_t>(std::move(name)))
+    { }
+
+    virtual
+    std::vector<std::shared_ptr<celero::UserDefinedMeasurement>>
+    getUserDefinedMeasurements() const {
+        return { measurement };
+    }
+
+protected:
+    // Records the value of the sample which has just finished.
+    void
+    report(double value) {
+        measurement->addValue(value);
+    }
+
+private:
+    struct measurement_t:
+        public celero::UserDefinedMeasurementTemplate<double>
+    {
+        explicit
+        measurement_t(std::string name_):
+            name(std::move(name_))
+        { }
+
+        virtual
+        std::string
+        getName() const {
+            return name;
+        }
+
+    private:
+        const std::string name;
+    };
+
+    const std::shared_ptr<measurement_t> measurement;
+};
+
+}} // namespace cocaine::benchmark
+
+#endif
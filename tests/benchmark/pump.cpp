@@ -0,0 +1,194 @@
+/*
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/defaults.hpp"
+#include "cocaine/errors.hpp"
+#include "cocaine/idl/storage.hpp"
+
+#include "cocaine/rpc/asio/decoder.hpp"
+#include "cocaine/rpc/asio/encoder.hpp"
+#include "cocaine/rpc/asio/transport.hpp"
+#include "cocaine/rpc/dispatch.hpp"
+#include "cocaine/rpc/session.hpp"
+
+#include <asio/io_service.hpp>
+#include <asio/local/connect_pair.hpp>
+#include <asio/local/stream_protocol.hpp>
+#include <asio/write.hpp>
+
+#include <blackhole/root.hpp>
+
+#include <metrics/registry.hpp>
+
+#include <celero/Celero.h>
+
+#include <cstring>
+
+namespace {
+
+using namespace cocaine;
+
+typedef asio::local::stream_protocol protocol_type;
+typedef protocol_type::socket socket_type;
+
+// Number of small RPCs the client pipelines at once.
+const size_t kPipelineDepth = 64;
+
+// Pipelines a burst of small RPCs into a session over a socket pair and waits for all the replies.
+// The session either handles one message per reactor turn, as sessions used to do, or drains the
+// already buffered ones with the default budget. Celero reports the result in bursts per second.
+template<bool Batched>
+struct pump_fixture_t:
+    public celero::TestFixture
+{
+    std::unique_ptr<asio::io_service> asio;
+    std::unique_ptr<socket_type> client;
+
+    metrics::registry_t hub;
+    std::shared_ptr<session<protocol_type>> server;
+
+    io::encoder_t encoder;
+    io::decoder_t decoder;
+
+    uint64_t channel_id;
+
+    std::string burst;
+    std::vector<char> reply;
+
+    size_t received;
+    size_t replies;
+
+    virtual
+    void
+    setUp(int64_t) {
+        asio.reset(new asio::io_service());
+        client.reset(new socket_type(*asio));
+
+        auto socket = std::make_unique<socket_type>(*asio);
+
+        asio::local::connect_pair(*client, *socket);
+
+        auto prototype = std::make_shared<dispatch<io::storage_tag>>("pump");
+        prototype->on<io::storage::read>([](const std::string&, const std::string&) -> std::string {
+            return "value";
+        });
+
+        server = std::make_shared<session<protocol_type>>(
+            std::make_unique<blackhole::root_logger_t>(std::vector<std::unique_ptr<blackhole::handler_t>>()),
+            hub,
+            std::make_unique<io::transport<protocol_type>>(std::move(socket)),
+            prototype
+        );
+
+        server->set_budget(Batched ? defaults::pull_budget : 1);
+        server->pull();
+
+        // Channel numbers must always grow, so they are carried over between the bursts.
+        channel_id = 0;
+
+        reply.resize(65536);
+    }
+
+    virtual
+    void
+    tearDown() {
+        server->detach(std::error_code());
+        server.reset();
+
+        asio->poll();
+
+        client.reset();
+        asio.reset();
+    }
+
+    void
+    pump() {
+        burst.clear();
+
+        for(size_t i = 0; i < kPipelineDepth; ++i) {
+            const auto encoded = encoder.encode(io::encoded<io::storage::read>(++channel_id, "collection", "key"));
+            burst.append(encoded.data(), encoded.size());
+        }
+
+        asio::write(*client, asio::buffer(burst));
+
+        received = 0;
+        replies = 0;
+
+        read();
+
+        while(replies < kPipelineDepth) {
+            asio->run_one();
+        }
+    }
+
+private:
+    void
+    read() {
+        client->async_read_some(asio::buffer(reply.data() + received, reply.size() - received),
+            [=](const std::error_code& ec, size_t size)
+        {
+            if(ec) {
+                throw std::system_error(ec, "unable to read the replies");
+            }
+
+            received += size;
+
+            on_data();
+        });
+    }
+
+    void
+    on_data() {
+        io::decoder_t::message_type message;
+        std::error_code ec;
+
+        while(received) {
+            const size_t size = decoder.decode(reply.data(), received, message, ec);
+
+            if(ec == error::insufficient_bytes) {
+                break;
+            } else if(ec) {
+                throw std::system_error(ec, "unable to decode the replies");
+            }
+
+            std::memmove(reply.data(), reply.data() + size, received - size);
+            received -= size;
+
+            ++replies;
+        }
+
+        if(replies < kPipelineDepth) {
+            read();
+        }
+    }
+};
+
+typedef pump_fixture_t<false> per_message_fixture_t;
+typedef pump_fixture_t<true>  batched_fixture_t;
+
+} // namespace
+
+BASELINE_F (PipelinedPump, PerMessage, per_message_fixture_t, 10, 10000) {
+    pump();
+}
+
+BENCHMARK_F(PipelinedPump, Batched,    batched_fixture_t,     10, 10000) {
+    pump();
+}
@@ -0,0 +1,124 @@
+/*
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/idl/storage.hpp"
+
+#include "cocaine/rpc/asio/decoder.hpp"
+#include "cocaine/rpc/dispatch.hpp"
+
+#include <celero/Celero.h>
+
+namespace {
+
+using namespace cocaine;
+
+// Rejects garbage frames either by catching the exceptions thrown by the dispatch, as sessions used
+// to do, or via the error code reporting path.
+template<bool Unbound>
+struct rejection_fixture_t:
+    public celero::TestFixture
+{
+    std::shared_ptr<dispatch<io::storage_tag>> prototype;
+
+    std::string frame;
+    io::decoder_t decoder;
+    io::decoder_t::message_type message;
+
+    virtual
+    void
+    setUp(int64_t) {
+        prototype = std::make_shared<dispatch<io::storage_tag>>("rejection");
+        prototype->on<io::storage::read>([](const std::string&, const std::string&) -> std::string {
+            return std::string();
+        });
+
+        msgpack::sbuffer buffer;
+        msgpack::packer<msgpack::sbuffer> packer(buffer);
+
+        packer.pack_array(3);
+        packer.pack(1);
+
+        if(Unbound) {
+            // Valid arguments for an event without a slot.
+            packer.pack(static_cast<int>(io::event_traits<io::storage::remove>::id));
+            packer.pack_array(2);
+            packer.pack(std::string("collection"));
+            packer.pack(std::string("key"));
+        } else {
+            // Integers where strings are expected.
+            packer.pack(static_cast<int>(io::event_traits<io::storage::read>::id));
+            packer.pack_array(2);
+            packer.pack(42);
+            packer.pack(42);
+        }
+
+        frame.assign(buffer.data(), buffer.size());
+
+        std::error_code ec;
+
+        if(!decoder.decode(frame.data(), frame.size(), message, ec) || ec) {
+            throw std::runtime_error("unable to decode the frame");
+        }
+    }
+
+    virtual
+    void
+    tearDown() {
+        prototype.reset();
+    }
+
+    void
+    throwing() {
+        try {
+            prototype->process(message, nullptr);
+        } catch(const std::system_error& e) {
+            celero::DoNotOptimizeAway(e.code().value());
+        }
+    }
+
+    void
+    error_code() {
+        std::error_code ec;
+
+        prototype->try_process(message, nullptr, ec);
+
+        celero::DoNotOptimizeAway(ec.value());
+    }
+};
+
+typedef rejection_fixture_t<true>  unbound_fixture_t;
+typedef rejection_fixture_t<false> malformed_fixture_t;
+
+} // namespace
+
+BASELINE_F (RejectUnboundSlot, Throwing,  unbound_fixture_t, 10, 100000) {
+    throwing();
+}
+
+BENCHMARK_F(RejectUnboundSlot, ErrorCode, unbound_fixture_t, 10, 100000) {
+    error_code();
+}
+
+BASELINE_F (RejectMalformedArguments, Throwing,  malformed_fixture_t, 10, 100000) {
+    throwing();
+}
+
+BENCHMARK_F(RejectMalformedArguments, ErrorCode, malformed_fixture_t, 10, 100000) {
+    error_code();
+}
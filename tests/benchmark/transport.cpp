@@ -0,0 +1,234 @@
+/*
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/idl/streaming.hpp"
+
+#include "cocaine/rpc/asio/transport.hpp"
+#include "cocaine/rpc/asio/uring.hpp"
+
+#include <asio/io_service.hpp>
+#include <asio/local/stream_protocol.hpp>
+
+#include <msgpack.hpp>
+
+#include "measurement.hpp"
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+using namespace cocaine;
+
+typedef io::streaming<boost::mpl::list<std::string>::type> protocol_type;
+typedef io::transport<asio::local::stream_protocol> transport_type;
+
+// Number of concurrent connections, as long as the descriptor limit allows.
+const size_t kConnections = 10000;
+
+auto
+thread_cpu_time() -> double {
+    timespec ts;
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Server side of a connection, answers every request with a chunk.
+struct echo_t:
+    public std::enable_shared_from_this<echo_t>
+{
+    std::shared_ptr<transport_type> transport;
+    io::decoder_t::message_type message;
+
+    size_t* served;
+
+    void
+    pull() {
+        transport->reader->read(message, std::bind(&echo_t::on_read, shared_from_this(), std::placeholders::_1));
+    }
+
+    void
+    on_read(const std::error_code& ec) {
+        if(ec) {
+            return;
+        }
+
+        std::error_code error;
+
+        do {
+            transport->writer->write(io::encoded<protocol_type::chunk>(message.span(), std::string("pong")), nullptr);
+            ++*served;
+        } while(transport->reader->read_buffered(message, error) && !error);
+
+        pull();
+    }
+};
+
+// Sends a request over every connection and runs the reactor until all of them are answered. Reports
+// the CPU time the reactor thread spends per request, the client side is not accounted.
+template<bool Uring>
+struct transport_fixture_t:
+    public benchmark::measured_fixture_t
+{
+    std::unique_ptr<asio::io_service> asio;
+    std::shared_ptr<io::uring_t> uring;
+
+    std::vector<std::shared_ptr<echo_t>> echoes;
+    std::vector<int> clients;
+
+    std::string request;
+    std::vector<char> buffer;
+
+    size_t served;
+    size_t requests;
+    double cpu;
+
+    transport_fixture_t():
+        measured_fixture_t("reactor CPU per request, us")
+    { }
+
+    virtual
+    void
+    setUp(int64_t) {
+        asio.reset(new asio::io_service());
+
+        if(Uring) {
+            uring = std::make_shared<io::uring_t>(*asio);
+        }
+
+        // Two descriptors per connection plus some slack.
+        rlimit limit;
+
+        ::getrlimit(RLIMIT_NOFILE, &limit);
+        limit.rlim_cur = limit.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &limit);
+
+        const size_t connections = std::min<size_t>(kConnections, (limit.rlim_cur - 64) / 2);
+
+        served = 0;
+
+        for(size_t i = 0; i < connections; ++i) {
+            int fds[2];
+
+            if(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+                throw std::system_error(errno, std::system_category(), "unable to create a connection");
+            }
+
+            auto echo = std::make_shared<echo_t>();
+
+            echo->transport = std::make_shared<transport_type>(
+                std::make_unique<transport_type::socket_type>(*asio, asio::local::stream_protocol(), fds[0]),
+                uring
+            );
+            echo->served = &served;
+            echo->pull();
+
+            echoes.push_back(echo);
+            clients.push_back(fds[1]);
+        }
+
+        msgpack::sbuffer frame;
+        msgpack::packer<msgpack::sbuffer> packer(frame);
+
+        packer.pack_array(3);
+        packer.pack(1);
+        packer.pack(0);
+        packer.pack_array(1);
+        packer.pack(std::string("ping"));
+
+        request.assign(frame.data(), frame.size());
+        buffer.resize(65536);
+
+        requests = 0;
+        cpu = 0;
+
+        // Arm the reads.
+        asio->poll();
+        asio->reset();
+    }
+
+    virtual
+    void
+    tearDown() {
+        if(requests) {
+            report(cpu / requests * 1e6);
+        }
+
+        for(auto it = clients.begin(); it != clients.end(); ++it) {
+            ::close(*it);
+        }
+
+        clients.clear();
+
+        // The peers are gone, so the reads complete with errors and release the connections.
+        asio->poll();
+        asio->reset();
+
+        echoes.clear();
+        asio->poll();
+
+        uring.reset();
+        asio.reset();
+    }
+
+    void
+    round() {
+        for(auto it = clients.begin(); it != clients.end(); ++it) {
+            if(::write(*it, request.data(), request.size()) != static_cast<ssize_t>(request.size())) {
+                throw std::runtime_error("unable to send a request");
+            }
+        }
+
+        const size_t expected = served + clients.size();
+        const double started = thread_cpu_time();
+
+        while(served < expected) {
+            asio->run_one();
+        }
+
+        // Submit the responses issued during the last turn.
+        asio->poll();
+        asio->reset();
+
+        cpu += thread_cpu_time() - started;
+        requests += clients.size();
+
+        for(auto it = clients.begin(); it != clients.end(); ++it) {
+            while(::recv(*it, buffer.data(), buffer.size(), MSG_DONTWAIT) > 0) {
+                // Drain.
+            }
+        }
+    }
+};
+
+typedef transport_fixture_t<false> asio_fixture_t;
+typedef transport_fixture_t<true>  uring_fixture_t;
+
+} // namespace
+
+BASELINE_F (TransportRoundTrip, Asio,  asio_fixture_t,  5, 10) {
+    round();
+}
+
+BENCHMARK_F(TransportRoundTrip, Uring, uring_fixture_t, 5, 10) {
+    round();
+}
@@ -0,0 +1,129 @@
+/*
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/idl/locator.hpp"
+#include "cocaine/idl/storage.hpp"
+
+#include "cocaine/traits/slice.hpp"
+#include "cocaine/traits/tuple.hpp"
+#include "cocaine/traits/vector.hpp"
+
+#include <celero/Celero.h>
+
+namespace {
+
+using namespace cocaine;
+
+// Unpacks the arguments of typical locator and storage invocations, either with the recursive
+// sequence traits or with the flat unpackers.
+template<class Event>
+struct unpack_fixture_t:
+    public celero::TestFixture
+{
+    typedef io::event_traits<Event> traits_type;
+
+    msgpack::sbuffer buffer;
+    msgpack::unpacked unpacked;
+
+    typename traits_type::tuple_type args;
+
+    template<class... Args>
+    void
+    prepare(const Args&... values) {
+        buffer.clear();
+
+        msgpack::packer<msgpack::sbuffer> packer(buffer);
+        io::type_traits<typename traits_type::argument_type>::pack(packer, values...);
+
+        msgpack::unpack(&unpacked, buffer.data(), buffer.size());
+    }
+
+    void
+    recursive() {
+        io::type_traits<typename traits_type::argument_type>::unpack(unpacked.get(), args);
+    }
+
+    void
+    flat() {
+        if(io::flat_unpacker<typename traits_type::argument_type>::unpack(unpacked.get(), args)) {
+            throw std::runtime_error("unable to unpack the arguments");
+        }
+    }
+};
+
+struct resolve_fixture_t:
+    public unpack_fixture_t<io::locator::resolve>
+{
+    virtual
+    void
+    setUp(int64_t) {
+        prepare(std::string("storage"), std::string("seed"));
+    }
+};
+
+struct write_fixture_t:
+    public unpack_fixture_t<io::storage::write>
+{
+    virtual
+    void
+    setUp(int64_t) {
+        prepare(
+            std::string("collection"),
+            std::string("key"),
+            std::string(1024, 'x'),
+            std::vector<std::string>{"tag-1", "tag-2", "tag-3"}
+        );
+    }
+};
+
+struct find_fixture_t:
+    public unpack_fixture_t<io::storage::find>
+{
+    virtual
+    void
+    setUp(int64_t) {
+        prepare(std::string("collection"), std::vector<std::string>{"tag-1", "tag-2", "tag-3"});
+    }
+};
+
+} // namespace
+
+BASELINE_F (UnpackResolve, Recursive, resolve_fixture_t, 10, 100000) {
+    recursive();
+}
+
+BENCHMARK_F(UnpackResolve, Flat,      resolve_fixture_t, 10, 100000) {
+    flat();
+}
+
+BASELINE_F (UnpackWrite, Recursive, write_fixture_t, 10, 100000) {
+    recursive();
+}
+
+BENCHMARK_F(UnpackWrite, Flat,      write_fixture_t, 10, 100000) {
+    flat();
+}
+
+BASELINE_F (UnpackFind, Recursive, find_fixture_t, 10, 100000) {
+    recursive();
+}
+
+BENCHMARK_F(UnpackFind, Flat,      find_fixture_t, 10, 100000) {
+    flat();
+}
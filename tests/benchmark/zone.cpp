@@ -0,0 +1,153 @@
+/*
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/rpc/asio/decoder.hpp"
+
+#include <msgpack.hpp>
+
+#include "measurement.hpp"
+
+#include <atomic>
+
+namespace {
+
+// Number of heap allocations made by this process so far. Only counted on glibc, where the
+// allocator can be wrapped without any linker tricks.
+// NOTE: The wrapper applies to the whole process, so this benchmark is built into an executable of
+// its own, instead of slowing down every other one.
+std::atomic<size_t> allocations(0);
+
+} // namespace
+
+#if defined(__GLIBC__)
+extern "C" void* __libc_malloc(size_t size);
+
+extern "C" void*
+malloc(size_t size) noexcept {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+#endif
+
+namespace {
+
+using namespace cocaine;
+
+// Decodes the same frame over and over again, either clearing the zone every time, which is what
+// the decoder did before, or retaining the zone chunk between frames. Reports the number of heap
+// allocations per frame.
+template<size_t FrameSize, size_t ZoneLimit>
+struct zone_fixture_t:
+    public benchmark::measured_fixture_t
+{
+    std::string frame;
+
+    std::unique_ptr<io::decoder_t> decoder;
+    io::decoder_t::message_type message;
+
+    size_t frames;
+    size_t baseline;
+
+    zone_fixture_t():
+        measured_fixture_t("allocations per frame")
+    { }
+
+    virtual
+    void
+    setUp(int64_t) {
+        msgpack::sbuffer buffer;
+        msgpack::packer<msgpack::sbuffer> packer(buffer);
+
+        packer.pack_array(3);
+        packer.pack(1);
+        packer.pack(0);
+
+        // Each element takes 8 bytes, so that's the number of objects a frame of this size can have
+        // when packed with short strings, like tags or keys.
+        packer.pack_array(FrameSize / 8);
+
+        for(size_t i = 0; i < FrameSize / 8; ++i) {
+            packer.pack(std::string("element"));
+        }
+
+        frame.assign(buffer.data(), buffer.size());
+        decoder.reset(new io::decoder_t(ZoneLimit));
+
+        frames = 0;
+        baseline = allocations.load();
+    }
+
+    virtual
+    void
+    tearDown() {
+        if(frames) {
+            report(double(allocations.load() - baseline) / frames);
+        }
+
+        decoder.reset();
+    }
+
+    void
+    decode() {
+        std::error_code ec;
+
+        if(decoder->decode(frame.data(), frame.size(), message, ec) != frame.size() || ec) {
+            throw std::runtime_error("unable to decode the frame");
+        }
+
+        ++frames;
+    }
+};
+
+typedef zone_fixture_t<1024, 0> cleared_1k_fixture_t;
+typedef zone_fixture_t<1024, io::decoder_t::kZoneLimit> retained_1k_fixture_t;
+
+typedef zone_fixture_t<8192, 0> cleared_8k_fixture_t;
+typedef zone_fixture_t<8192, io::decoder_t::kZoneLimit> retained_8k_fixture_t;
+
+typedef zone_fixture_t<65536, 0> cleared_64k_fixture_t;
+typedef zone_fixture_t<65536, io::decoder_t::kZoneLimit> retained_64k_fixture_t;
+
+} // namespace
+
+BASELINE_F (DecodeFrame1K, Cleared,  cleared_1k_fixture_t,  10, 10000) {
+    decode();
+}
+
+BENCHMARK_F(DecodeFrame1K, Retained, retained_1k_fixture_t, 10, 10000) {
+    decode();
+}
+
+BASELINE_F (DecodeFrame8K, Cleared,  cleared_8k_fixture_t,  10, 10000) {
+    decode();
+}
+
+BENCHMARK_F(DecodeFrame8K, Retained, retained_8k_fixture_t, 10, 10000) {
+    decode();
+}
+
+BASELINE_F (DecodeFrame64K, Cleared,  cleared_64k_fixture_t,  10, 1000) {
+    decode();
+}
+
+BENCHMARK_F(DecodeFrame64K, Retained, retained_64k_fixture_t, 10, 1000) {
+    decode();
+}
+
+CELERO_MAIN
@@ -0,0 +1,29 @@
+#include <gtest/gtest.h>
+
+#include <cocaine/cpuset.hpp>
+#include <cocaine/errors.hpp>
+
+namespace cocaine {
+namespace {
+
+TEST(cpuset_t, parse) {
+    EXPECT_EQ("0-3,8,10-11", cpuset_t("0-3,8,10-11").string());
+    EXPECT_EQ("1-2,5", cpuset_t(" 5, 1-2,2\n").string());
+    EXPECT_TRUE(cpuset_t("").empty());
+}
+
+TEST(cpuset_t, parse_malformed) {
+    EXPECT_THROW(cpuset_t("3x"), cocaine::error_t);
+    EXPECT_THROW(cpuset_t("5-2"), cocaine::error_t);
+    EXPECT_THROW(cpuset_t("1-"), cocaine::error_t);
+    EXPECT_THROW(cpuset_t("1-3-4"), cocaine::error_t);
+}
+
+TEST(cpuset_t, contains) {
+    EXPECT_TRUE(cpuset_t("0-7").contains(cpuset_t("2-3,6")));
+    EXPECT_TRUE(cpuset_t("0-7").contains(cpuset_t()));
+    EXPECT_FALSE(cpuset_t("0-1").contains(cpuset_t("1-2")));
+}
+
+} // namespace
+} // namespace cocaine
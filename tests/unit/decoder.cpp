@@ -0,0 +1,208 @@
+/*
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cocaine/errors.hpp>
+#include <cocaine/rpc/asio/decoder.hpp>
+
+#include <gtest/gtest.h>
+
+#include <msgpack.hpp>
+
+using namespace cocaine;
+using namespace cocaine::io;
+
+namespace {
+
+std::string
+frame(uint64_t span, uint64_t type, const std::string& blob) {
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+
+    packer.pack_array(3);
+    packer.pack(span);
+    packer.pack(type);
+    packer.pack_array(2);
+    packer.pack(blob);
+    packer.pack_map(1);
+    packer.pack(std::string("key"));
+    packer.pack(42.0);
+
+    return std::string(buffer.data(), buffer.size());
+}
+
+std::string
+frame(uint64_t span, uint64_t type, size_t elements) {
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+
+    packer.pack_array(3);
+    packer.pack(span);
+    packer.pack(type);
+    packer.pack_array(elements);
+
+    for(size_t i = 0; i < elements; ++i) {
+        packer.pack(std::string("element"));
+    }
+
+    return std::string(buffer.data(), buffer.size());
+}
+
+} // namespace
+
+TEST(frame_scanner_t, byte_by_byte) {
+    const auto data = frame(1, 2, std::string(70000, 'x'));
+
+    aux::frame_scanner_t scanner;
+    std::error_code ec;
+
+    for(size_t size = 0; size < data.size(); ++size) {
+        ASSERT_FALSE(scanner.scan(data.data(), size, ec));
+        ASSERT_FALSE(ec);
+        ASSERT_LE(scanner.expected(), data.size());
+    }
+
+    ASSERT_TRUE(scanner.scan(data.data(), data.size(), ec));
+    ASSERT_FALSE(ec);
+    ASSERT_EQ(data.size(), scanner.size());
+}
+
+TEST(frame_scanner_t, declared_length) {
+    const auto data = frame(1, 2, std::string(70000, 'x'));
+
+    aux::frame_scanner_t scanner;
+    std::error_code ec;
+
+    // Enough to see the blob header, i.e. the length of the blob.
+    ASSERT_FALSE(scanner.scan(data.data(), 16, ec));
+    ASSERT_GE(scanner.expected(), 70000u);
+    ASSERT_LE(scanner.expected(), data.size());
+}
+
+TEST(frame_scanner_t, objects) {
+    const auto data = frame(1, 2, "blob");
+
+    aux::frame_scanner_t scanner;
+    std::error_code ec;
+
+    ASSERT_TRUE(scanner.scan(data.data(), data.size(), ec));
+
+    // Three frame elements, two arguments and a key-value pair.
+    ASSERT_EQ(7u, scanner.objects());
+
+    scanner.reset();
+    ASSERT_EQ(0u, scanner.objects());
+}
+
+TEST(frame_scanner_t, reserved_type) {
+    const char data[] = { '\x93', '\xC1' };
+
+    aux::frame_scanner_t scanner;
+    std::error_code ec;
+
+    ASSERT_FALSE(scanner.scan(data, sizeof(data), ec));
+    ASSERT_EQ(error::parse_error, ec);
+}
+
+TEST(decoder_t, chunked) {
+    const auto data = frame(1, 2, "blob") + frame(3, 4, "blob");
+
+    decoder_t decoder;
+    decoder_t::message_type message;
+    std::error_code ec;
+
+    for(size_t size = 0; size < data.size() / 2; ++size) {
+        ASSERT_EQ(0u, decoder.decode(data.data(), size, message, ec));
+        ASSERT_EQ(error::insufficient_bytes, ec);
+        ec.clear();
+    }
+
+    const size_t offset = decoder.decode(data.data(), data.size(), message, ec);
+
+    ASSERT_FALSE(ec);
+    ASSERT_EQ(data.size() / 2, offset);
+    ASSERT_EQ(1u, message.span());
+    ASSERT_EQ(2u, message.type());
+
+    ASSERT_EQ(data.size() / 2, decoder.decode(data.data() + offset, data.size() - offset, message, ec));
+    ASSERT_FALSE(ec);
+    ASSERT_EQ(3u, message.span());
+    ASSERT_EQ(4u, message.type());
+}
+
+TEST(decoder_t, zone_reuse) {
+    decoder_t decoder(64 * 1024);
+    decoder_t::message_type message;
+    std::error_code ec;
+
+    // Frames which fit into the initial chunk, into the grown one and the ones exceeding the limit.
+    for(size_t elements: {16, 1024, 16, 3000, 100000, 1024, 100000}) {
+        const auto data = frame(1, 2, elements);
+
+        ASSERT_EQ(data.size(), decoder.decode(data.data(), data.size(), message, ec));
+        ASSERT_FALSE(ec);
+        ASSERT_EQ(elements, message.args().via.array.size);
+        ASSERT_EQ("element", message.args().via.array.ptr[elements - 1].as<std::string>());
+    }
+}
+
+TEST(decoder_t, zone_shrink) {
+    decoder_t decoder;
+    decoder_t::message_type message;
+    std::error_code ec;
+
+    const auto large = frame(1, 2, 3000);
+    const auto small = frame(1, 2, 16);
+
+    ASSERT_EQ(large.size(), decoder.decode(large.data(), large.size(), message, ec));
+    ASSERT_GT(decoder.retained(), static_cast<size_t>(MSGPACK_ZONE_CHUNK_SIZE));
+
+    for(size_t i = 0; i < decoder_t::kShrinkAfter; ++i) {
+        ASSERT_GT(decoder.retained(), static_cast<size_t>(MSGPACK_ZONE_CHUNK_SIZE));
+        ASSERT_EQ(small.size(), decoder.decode(small.data(), small.size(), message, ec));
+        ASSERT_FALSE(ec);
+    }
+
+    ASSERT_EQ(static_cast<size_t>(MSGPACK_ZONE_CHUNK_SIZE), decoder.retained());
+    ASSERT_EQ(16u, message.args().via.array.size);
+}
+
+TEST(frame_scanner_t, frame_limit) {
+    // An array of three elements, the last one being a string of 4 GiB minus one byte.
+    const char data[] = { '\x93', '\x01', '\x02', '\xDB', '\xFF', '\xFF', '\xFF', '\xFF' };
+
+    aux::frame_scanner_t scanner(1024 * 1024);
+    std::error_code ec;
+
+    ASSERT_FALSE(scanner.scan(data, sizeof(data) - 1, ec));
+    ASSERT_FALSE(ec);
+
+    ASSERT_FALSE(scanner.scan(data, sizeof(data), ec));
+    ASSERT_EQ(error::frame_too_large, ec);
+}
+
+TEST(decoder_t, frame_limit) {
+    const auto data = frame(1, 2, std::string(70000, 'x'));
+
+    decoder_t decoder(decoder_t::kZoneLimit, 65536);
+    decoder_t::message_type message;
+    std::error_code ec;
+
+    ASSERT_EQ(0u, decoder.decode(data.data(), 16, message, ec));
+    ASSERT_EQ(error::frame_too_large, ec);
+}
@@ -0,0 +1,82 @@
+/*
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cocaine/errors.hpp>
+#include <cocaine/idl/storage.hpp>
+#include <cocaine/idl/streaming.hpp>
+#include <cocaine/rpc/asio/decoder.hpp>
+#include <cocaine/rpc/asio/encoder.hpp>
+
+#include <gtest/gtest.h>
+
+using namespace cocaine;
+
+namespace {
+
+typedef io::streaming<boost::mpl::list<std::string>::type> protocol_type;
+
+auto
+flatten(const io::encoder_t::encoded_message_type& message) -> std::string {
+    std::string result;
+
+    message.for_each([&](const char* data, size_t size) {
+        result.append(data, size);
+    });
+
+    return result;
+}
+
+} // namespace
+
+TEST(encoder_t, encodes_referenced_payload_twice) {
+    const io::encoded<protocol_type::chunk> message(1, std::string(65536, 'x'));
+
+    // Same message sent over multiple upstreams, each having its own encoder.
+    io::encoder_t first, second;
+
+    const auto a = first.encode(message);
+    const auto b = second.encode(message);
+
+    ASSERT_FALSE(a.contiguous());
+    ASSERT_GT(a.size(), 65536u);
+    ASSERT_EQ(flatten(a), flatten(b));
+}
+
+TEST(encoder_t, grows_past_estimated_size) {
+    // Nested arguments are not measured beforehand, so the buffer has to grow while packing them.
+    const std::vector<std::string> tags(1000, std::string("tag"));
+    const io::encoded<io::storage::find> message(1, std::string("collection"), tags);
+
+    io::encoder_t encoder;
+
+    const auto encoded = encoder.encode(message);
+    const auto data = flatten(encoded);
+
+    io::decoder_t decoder;
+    io::decoder_t::message_type decoded;
+
+    std::error_code ec;
+
+    ASSERT_EQ(data.size(), decoder.decode(data.data(), data.size(), decoded, ec));
+    ASSERT_FALSE(ec);
+
+    ASSERT_EQ(static_cast<uint64_t>(io::event_traits<io::storage::find>::id), decoded.type());
+    ASSERT_EQ(2u, decoded.args().via.array.size);
+    ASSERT_EQ(tags.size(), decoded.args().via.array.ptr[1].via.array.size);
+}
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+
+#include <cocaine/executor/stealing.hpp>
+
+#include <atomic>
+
+namespace cocaine {
+namespace {
+
+void
+split(executor::stealing_t& executor, std::atomic<int>& leaves, int depth) {
+    if(depth == 0) {
+        ++leaves;
+        return;
+    }
+
+    for(int i = 0; i < 2; ++i) {
+        executor.spawn([&executor, &leaves, depth]() noexcept {
+            split(executor, leaves, depth - 1);
+        });
+    }
+}
+
+TEST(stealing_t, completes_work_on_destruction) {
+    std::atomic<int> completed(0);
+
+    {
+        executor::stealing_t executor(4);
+
+        for(int i = 0; i < 10000; ++i) {
+            executor.spawn([&]() noexcept {
+                ++completed;
+            });
+        }
+    }
+
+    EXPECT_EQ(10000, completed.load());
+}
+
+TEST(stealing_t, completes_nested_work) {
+    std::atomic<int> leaves(0);
+
+    {
+        executor::stealing_t executor(4);
+        split(executor, leaves, 12);
+    }
+
+    EXPECT_EQ(1 << 12, leaves.load());
+}
+
+TEST(stealing_t, rejects_work_once_stopped) {
+    std::atomic<int> leaves(0);
+
+    executor::stealing_t executor(4);
+    split(executor, leaves, 8);
+
+    executor.stop();
+
+    // The work spawned before stopping is completed, including the work spawned by itself.
+    EXPECT_EQ(1 << 8, leaves.load());
+
+    EXPECT_THROW(executor.spawn([]() noexcept {}), std::system_error);
+
+    // Stopping again is fine, as is destroying the stopped executor.
+    executor.stop();
+}
+
+} // namespace
+} // namespace cocaine
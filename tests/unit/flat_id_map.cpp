@@ -0,0 +1,85 @@
+/*
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cocaine/utility/flat_id_map.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+namespace {
+
+using cocaine::utility::flat_id_map;
+
+TEST(flat_id_map, InsertFindErase) {
+    flat_id_map<std::string> map;
+
+    EXPECT_TRUE(map.insert(1, "one").second);
+    EXPECT_TRUE(map.insert(2, "two").second);
+    EXPECT_FALSE(map.insert(1, "uno").second);
+
+    ASSERT_EQ(2, map.size());
+    ASSERT_NE(nullptr, map.find(1));
+    EXPECT_EQ("one", *map.find(1));
+    EXPECT_EQ(nullptr, map.find(3));
+
+    EXPECT_EQ(1, map.erase(1));
+    EXPECT_EQ(0, map.erase(1));
+    EXPECT_EQ(nullptr, map.find(1));
+    EXPECT_EQ("two", *map.find(2));
+    EXPECT_EQ(1, map.size());
+}
+
+TEST(flat_id_map, BehavesLikeMap) {
+    flat_id_map<std::uint64_t> map;
+    std::map<std::uint64_t, std::uint64_t> expected;
+
+    std::mt19937_64 random(42);
+
+    // Strided keys collide a lot without proper mixing, exercising both probing and backward shifts.
+    for(std::uint64_t i = 0; i < 100000; ++i) {
+        const std::uint64_t key = (random() % 4096) * 1024;
+
+        if(random() % 2) {
+            EXPECT_EQ(expected.insert({key, i}).second, map.insert(key, i).second);
+        } else {
+            EXPECT_EQ(expected.erase(key), map.erase(key));
+        }
+    }
+
+    ASSERT_EQ(expected.size(), map.size());
+
+    std::size_t visited = 0;
+
+    for(auto it = map.begin(); it != map.end(); ++it, ++visited) {
+        ASSERT_EQ(1, expected.count(it.key()));
+        EXPECT_EQ(expected[it.key()], it.value());
+    }
+
+    EXPECT_EQ(expected.size(), visited);
+
+    map.clear();
+
+    EXPECT_TRUE(map.empty());
+    EXPECT_TRUE(map.begin() == map.end());
+}
+
+} // namespace
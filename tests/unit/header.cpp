@@ -56,3 +56,63 @@ TEST(header_t, general) {
     ASSERT_EQ(span3, span4);
 }
 
+
+TEST(header_t, borrow) {
+    std::string buffer("trace_idauthorizationx-custom0123456789");
+
+    auto trace = header_t::borrow(buffer.data(), 8, buffer.data() + 8, 13);
+    auto custom = header_t::borrow(buffer.data() + 21, 8, buffer.data() + 29, 10);
+
+    // Static table names are interned.
+    ASSERT_EQ(&trace.name(), &header_static_table_t::get_headers()[80].name());
+    ASSERT_EQ(custom.name(), "x-custom");
+
+    // Borrowed values are not copied until accessed.
+    ASSERT_EQ(buffer.data() + 29, custom.value_data());
+    ASSERT_EQ(10, custom.value_size());
+
+    // Copies own their data.
+    header_t copy(custom);
+    ASSERT_NE(buffer.data() + 29, copy.value_data());
+
+    buffer.assign(buffer.size(), 'x');
+
+    ASSERT_EQ("0123456789", copy.value());
+    ASSERT_EQ("xxxxxxxxxx", custom.value());
+}
+
+TEST(headers_t, inline_storage) {
+    headers_t headers;
+
+    ASSERT_TRUE(headers.empty());
+    ASSERT_EQ(headers_t::inline_capacity, headers.capacity());
+
+    for(size_t i = 0; i < 10; ++i) {
+        headers.emplace_back("name", std::to_string(i));
+
+        if(i == 0) {
+            // Copying one of the stored headers while relocating them must be fine too.
+            headers.push_back(headers.front());
+        }
+    }
+
+    ASSERT_EQ(11, headers.size());
+    ASSERT_EQ("0", headers[0].value());
+    ASSERT_EQ("0", headers[1].value());
+    ASSERT_EQ("9", headers.back().value());
+
+    headers_t moved(std::move(headers));
+    ASSERT_TRUE(headers.empty());
+    ASSERT_EQ(11, moved.size());
+
+    headers_t small = { header_t("a", "b") };
+    headers_t copy(small);
+    headers_t target(std::move(small));
+
+    ASSERT_EQ(copy, target);
+    ASSERT_TRUE(small.empty());
+
+    std::vector<header_t> vector = target;
+    ASSERT_EQ(target, headers_t(vector));
+    ASSERT_EQ("b", header::find_first(target, "a")->value());
+}
@@ -24,6 +24,8 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <msgpack.hpp>
+
 #include <random>
 
 using namespace cocaine::hpack;
@@ -270,3 +272,42 @@ TEST(header_table_t, complex_store_load) {
     }
 }
 
+
+TEST(msgpack_traits, compressed_roundtrip) {
+    header_table_t encoder_table;
+    header_table_t decoder_table;
+
+    headers_t source = {
+        header_t::create<headers::trace_id<>>(header::pack(uint64_t(42))),
+        header_t::create<headers::span_id<>>(header::pack(uint64_t(43))),
+        header_t::create<test_header_t>(),
+        header_t::create<another_test_header_t>()
+    };
+
+    std::vector<size_t> sizes;
+
+    for(size_t i = 0; i < 3; i++) {
+        msgpack::sbuffer buffer;
+        msgpack::packer<msgpack::sbuffer> packer(buffer);
+
+        packer.pack_array(source.size());
+        msgpack_traits::pack_compressed(packer, encoder_table, source[0]);
+        msgpack_traits::pack_unindexed(packer, encoder_table, source[1]);
+        msgpack_traits::pack_compressed(packer, encoder_table, source[2]);
+        msgpack_traits::pack_compressed(packer, encoder_table, source[3]);
+
+        msgpack::unpacked unpacked;
+        msgpack::unpack(&unpacked, buffer.data(), buffer.size());
+
+        headers_t result;
+        ASSERT_TRUE(msgpack_traits::unpack_vector(unpacked.get(), decoder_table, result));
+        ASSERT_EQ(source, result);
+        ASSERT_EQ(encoder_table.size(), decoder_table.size());
+
+        sizes.push_back(buffer.size());
+    }
+
+    // Indexed headers are sent as table references starting from the second time.
+    ASSERT_LT(sizes[1], sizes[0]);
+    ASSERT_EQ(sizes[1], sizes[2]);
+}
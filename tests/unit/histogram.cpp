@@ -0,0 +1,71 @@
+/*
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cocaine/utility/histogram.hpp>
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+using namespace cocaine::utility;
+
+TEST(histogram, quantile) {
+    histogram hist;
+
+    ASSERT_EQ(0u, hist.quantile(0.5));
+
+    for(std::uint64_t value = 1; value <= 100; ++value) {
+        hist.record(value);
+    }
+
+    ASSERT_EQ(100u, hist.count());
+
+    // Buckets have at most 12.5% relative error.
+    ASSERT_GE(hist.quantile(0.5), 50u);
+    ASSERT_LE(hist.quantile(0.5), 57u);
+    ASSERT_GE(hist.quantile(0.99), 99u);
+    ASSERT_LE(hist.quantile(0.99), 112u);
+
+    hist.reset();
+
+    ASSERT_EQ(0u, hist.count());
+    ASSERT_EQ(0u, hist.quantile(0.5));
+}
+
+TEST(windowed_histogram, expiration) {
+    windowed_histogram hist(std::chrono::milliseconds(50));
+
+    for(int i = 0; i < 100; ++i) {
+        hist.record(1000);
+    }
+
+    ASSERT_GE(hist.quantile(0.5), 1000u);
+
+    // Values outlive at most two intervals.
+    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+
+    ASSERT_EQ(0u, hist.quantile(0.5));
+
+    hist.record(10);
+
+    ASSERT_EQ(10u, hist.quantile(0.99));
+
+    // The total count is not windowed.
+    ASSERT_EQ(101u, hist.count());
+}
@@ -24,6 +24,7 @@ static_assert(
             io::storage::write,
             io::storage::remove,
             io::storage::find,
+            io::control::window_update,
             io::control::goaway,
             io::control::ping,
             io::control::settings,
@@ -32,4 +33,10 @@ static_assert(
     >::value,
     "`io::messages<T>::full` is broken");
 
+static_assert(
+    io::event_traits<io::control::revoke>::id == 65535 &&
+    io::event_traits<io::control::goaway>::id == 65532 &&
+    io::event_traits<io::control::window_update>::id == 65531,
+    "control event ids must not change when new control events are added");
+
 } // namespace cocaine
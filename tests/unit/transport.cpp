@@ -0,0 +1,80 @@
+/*
+    Copyright (c) 2011-2015 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cocaine/idl/streaming.hpp>
+#include <cocaine/rpc/asio/transport.hpp>
+
+#include <asio/generic/stream_protocol.hpp>
+#include <asio/io_service.hpp>
+#include <asio/local/connect_pair.hpp>
+#include <asio/local/stream_protocol.hpp>
+
+#include <gtest/gtest.h>
+
+using namespace cocaine;
+
+namespace {
+
+typedef io::streaming<boost::mpl::list<std::string>::type> protocol_type;
+
+typedef asio::local::stream_protocol::socket socket_type;
+
+// Engines configure typed transports, which sessions then convert into generic ones.
+auto
+convert(bool compression) -> std::pair<size_t, size_t> {
+    asio::io_service loop;
+
+    auto client = std::make_unique<socket_type>(loop);
+    socket_type server(loop);
+
+    asio::local::connect_pair(*client, server);
+
+    io::transport<asio::local::stream_protocol> typed(std::move(client));
+    typed.writer->encoder().set_compression(compression);
+
+    io::transport<asio::generic::stream_protocol> generic(std::move(typed));
+
+    EXPECT_EQ(compression, generic.writer->encoder().compressed());
+
+    const hpack::headers_t headers = {
+        hpack::header_t("x-request-id", "0123456789abcdef")
+    };
+
+    auto& encoder = generic.writer->encoder();
+
+    const auto first = encoder.encode(io::encoded<protocol_type::chunk>(1, headers, std::string("ping")));
+    const auto second = encoder.encode(io::encoded<protocol_type::chunk>(1, headers, std::string("ping")));
+
+    return std::make_pair(first.size(), second.size());
+}
+
+} // namespace
+
+TEST(transport, conversion_keeps_compression) {
+    const auto sizes = convert(true);
+
+    // Repeated headers are referenced from the dynamic table.
+    ASSERT_LT(sizes.second, sizes.first);
+}
+
+TEST(transport, conversion_keeps_no_compression) {
+    const auto sizes = convert(false);
+
+    ASSERT_EQ(sizes.first, sizes.second);
+}